@@ -1,8 +1,8 @@
 #include <wificonfig.h>
 
-/* max lengths of parameters to be obtained */
-#define MAX_SSID_LEN        32
-#define MAX_KEY_LEN         63
+/* max lengths of parameters to be obtained, the SSID and passkey as long as the portal accepts */
+#define MAX_SSID_LEN        WC_SSID_MAX_LEN
+#define MAX_KEY_LEN         WC_PASS_MAX_LEN
 #define MAX_SERVER_LEN      30
 #define MAX_UNAME_LEN       50
 #define MAX_PWD_LEN         50
@@ -34,6 +34,11 @@ void setup() {
   /* set a timeout of 120 seconds, by default there is no timeout */
   wcfg.setConfigPortalTimeout(120);
 
+  /* try the submitted network for up to 15 seconds before closing the portal,
+   *  so a wrong passkey can be fixed from the same page
+   */
+  wcfg.setConnectCheck(15);
+
   /* add the parameters created earlier.
    *  Pass a buffer to hold the parameters, 
    *  as well as the max number of bytes to be used in the buffer.
@@ -51,11 +56,22 @@ void setup() {
   Serial.println("Soft AP started");
 }
 
+/* keep running config_loop() until the portal has let go of its web server,
+ *  which it does once the last page still open has closed. Then stall */
+void releaseAndStall(unsigned long idle) {
+  while (idle != ULONG_MAX) {
+    delay(idle);
+    wcfg.config_loop(&idle);
+  }
+  while (1) yield();
+}
+
 void loop() {
-  /* constantly check the state of the config process */
-  uint8_t ret = wcfg.config_loop();
+  /* check the state of the config process, and find out how long until it next needs a look */
+  unsigned long idle;
+  uint8_t ret = wcfg.config_loop(&idle);
 
-  /* if it's completed, extract the results and print them, then stall */
+  /* if it's completed, extract the results and print them, then clean up and stall */
   if (ret == WIFICONFIG_COMPLETE) {
     Serial.println("Config details: \r\n");
     
@@ -67,11 +83,22 @@ void loop() {
     Serial.printf("Username: %s\r\n", uname);
     Serial.printf("Password: %s\r\n", pwd);
     Serial.printf("Server: %s\r\n", server);
-    while (1) yield();
+
+    /* check the credentials actually work. The AP gets remembered in RTC memory,
+     *  so after a reset or deep sleep, wcfg.fastConnect(ssid, key, 15000) can skip the scan */
+    if (wcfg.connect(ssid, key, 15000))
+      Serial.printf("Connected in %u ms\r\n", wcfg.getConnectStats().lastMs);
+    else
+      Serial.println("Couldn't connect with those details");
+    releaseAndStall(idle);
   }
-  /* if it timed out, simply stall forever */
+  /* if it timed out, clean up and stall forever */
   else if (ret == WIFICONFIG_TIMEOUT) {
     Serial.println("Config timed out.");
-    while (1) yield();
+    releaseAndStall(idle);
+  }
+  /* nothing due before then, so there's no point spinning */
+  else if (ret == WIFICONFIG_INPROGRESS) {
+    delay(idle);
   }
 }
\ No newline at end of file
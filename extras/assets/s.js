@@ -0,0 +1,5 @@
+function c(l){document.getElementById('s').value=l.innerText||l.textContent;document.getElementById('p').focus();}
+function f(a){var n=document.getElementById('n');if(!n)return;n.innerHTML='';a.forEach(function(e){var d=document.createElement('div'),l=document.createElement('a'),q=document.createElement('span');l.href='#p';l.onclick=function(){c(l)};l.textContent=e[0];q.className=e[2]?'q l':'q';q.textContent=e[1]+'%';d.appendChild(l);d.appendChild(document.createTextNode(' '));d.appendChild(q);n.appendChild(d);});}
+function r(){var x=new XMLHttpRequest();x.onload=function(){if(x.status==200)f(JSON.parse(x.responseText));};x.open('GET','/scan');x.send();}
+window.onload=function(){if(window.V||!(document.getElementById('n')||document.getElementById('st')))return;if(!window.EventSource){if(document.getElementById('n'))setInterval(r,10000);return;}V=new EventSource('/events');V.addEventListener('scan',function(m){f(JSON.parse(m.data))});V.addEventListener('status',function(m){var s=document.getElementById('st');if(s)s.textContent=m.data;});};
+function w(f){var e=f.elements,b=[],x=new XMLHttpRequest();for(var i=0;i<e.length;i++){var t=e[i];if(!t.name||((t.type=='checkbox'||t.type=='radio')&&!t.checked))continue;b.push(encodeURIComponent(t.name)+'='+encodeURIComponent(t.value));}x.onload=function(){document.open();document.write(x.responseText);document.close();};x.open('POST',f.getAttribute('action'));x.setRequestHeader('Content-Type','application/x-wc-form');x.send(b.join('&'));return false;}
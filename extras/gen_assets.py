@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+"""
+Regenerates src/wcassets.h from the files in extras/assets.
+
+Each asset is gzip-compressed into a PROGMEM array, and gets a short content hash
+that's used to version its URL, so browsers can cache it forever.
+Run it from anywhere after editing an asset:  python3 extras/gen_assets.py
+"""
+
+import gzip
+import hashlib
+import os
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+# (file in extras/assets, C name)
+ASSETS = [
+    ("s.css", "STYLE"),
+    ("s.js", "SCRIPT"),
+]
+
+
+def c_array(data):
+    lines = []
+    for i in range(0, len(data), 16):
+        lines.append("    " + ", ".join("0x%02x" % b for b in data[i:i + 16]) + ",")
+    return "\n".join(lines)
+
+
+def main():
+    out = [
+        "/* Generated by extras/gen_assets.py from extras/assets, do not edit by hand */",
+        "",
+        "#ifndef WCAssets_h",
+        "#define WCAssets_h",
+        "",
+        "#include <Arduino.h>",
+        "",
+    ]
+    for fname, name in ASSETS:
+        with open(os.path.join(ROOT, "extras", "assets", fname), "rb") as f:
+            raw = f.read().strip()
+        gz = gzip.compress(raw, compresslevel=9, mtime=0)
+        digest = hashlib.sha256(raw).hexdigest()[:8]
+        out += [
+            "// %s: %d bytes, %d gzipped" % (fname, len(raw), len(gz)),
+            '#define WC_%s_HASH "%s"' % (name, digest),
+            "const uint8_t WC_%s_GZ[] PROGMEM = {" % name,
+            c_array(gz),
+            "};",
+            "",
+        ]
+    out += ["#endif", ""]
+
+    with open(os.path.join(ROOT, "src", "wcassets.h"), "w") as f:
+        f.write("\n".join(out))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,277 @@
+/**************************************************************
+   Microbenchmarks for WIFIConfig, on the host build.
+   Each one times a single operation over as many iterations as fit in
+   --min-time, and reports it the way Google Benchmark does, plus the heap
+   allocations, bytes allocated and heap high-water mark per iteration,
+   and items/s where an iteration handles several. Time is host CPU time,
+   useful for comparing builds rather than for predicting the device;
+   the allocation counts carry over, the stand-in server's own request
+   and response objects included, as the real one allocates those too.
+     wc_bench [--filter=<substring>] [--min-time=<seconds>]
+ **************************************************************/
+
+#include <wificonfig.h>
+#include "wchost.h"
+#include <DNSServer.h>
+#include <memory>
+#include <vector>
+
+#define WCBENCH_MAX_PARAMS  40
+#define WCBENCH_PARAM_LEN   20
+
+typedef WIFIConfigT<WCBENCH_MAX_PARAMS, WCBENCH_MAX_PARAMS * (WCBENCH_PARAM_LEN + 1)> BenchConfig;
+
+static const wchost::Network NETWORKS[] = {
+    { "HomeNet", -48, true }, { "Office-5G", -61, true }, { "CoffeeShop", -70, false },
+    { "Neighbour's <wifi>", -74, true }, { "Printer-Direct", -80, false }, { "Guest", -66, false },
+    { "IoT", -55, true }, { "Lab & Co", -83, true }, { "Mesh-2", -59, true }, { "FreeWiFi", -90, false },
+};
+
+/* a portal with 'count' parameters, past the AP settling and taking requests */
+class Portal {
+  public:
+    Portal(int count, size_t cacheBytes = 0) {
+        static char ids[WCBENCH_MAX_PARAMS][8];
+        wchost::setScanResults(NETWORKS, WC_ARRAY_LEN(NETWORKS));
+        for (int i = 0; i < count; i++) {
+            snprintf(ids[i], sizeof(ids[i]), "p%d", i);
+            _params.emplace_back(new WIFIConfigParam(ids[i], "Parameter"));
+            wc.addParameter(_params.back().get(), WCBENCH_PARAM_LEN, "value");
+        }
+        wc.setRequestRateLimit(0);
+        wc.setPageCacheSize(cacheBytes);
+        wc.startConfigPortal("bench");
+        // AP settling, then a scan so the page has networks to list
+        for (int i = 0; i < 100; i++) {
+            wc.config_loop();
+            wchost::advance(10);
+        }
+    }
+    ~Portal() {
+        // let it time out, which tears it all down
+        wc.setConfigPortalTimeout(1);
+        while (wc.config_loop() == WIFICONFIG_INPROGRESS)
+            wchost::advance(100);
+    }
+
+    BenchConfig   wc;
+  private:
+    std::vector<std::unique_ptr<WIFIConfigParam>> _params;
+};
+
+// one request over its own connection, the response taken as fast as the client can
+static int exchange(WebRequestMethod method, const char *url, const char *type = NULL, const char *body = NULL) {
+    wchost::Connection c;
+    c.keepBody = false;
+    if (!c.open(IPAddress(192, 168, 4, 2)))
+        return 0;
+    c.request(method, url, type, body);
+    while (c.pump())
+        ;
+    return c.code;
+}
+
+// a request up to its first segment out, then the client hangs up: time to first byte, hang-up included
+static void firstSegment(const char *url) {
+    wchost::Connection c;
+    c.keepBody = false;
+    if (!c.open(IPAddress(192, 168, 4, 2)))
+        return;
+    c.request(HTTP_GET, url);
+    while (c.received() == 0 && c.pump())
+        ;
+}
+
+static std::string formBody(int count) {
+    std::string body = "s=HomeNet&p=correct+horse+battery";
+    for (int i = 0; i < count; i++)
+        body += "&p" + std::to_string(i) + "=v%20" + std::to_string(i);
+    return body;
+}
+
+static std::string jsonBody(int count) {
+    std::string body = "{\"s\":\"HomeNet\",\"p\":\"correct horse battery\"";
+    for (int i = 0; i < count; i++)
+        body += ",\"p" + std::to_string(i) + "\":\"v\\u0020" + std::to_string(i) + "\"";
+    return body + "}";
+}
+
+/** Runner */
+struct Benchmark {
+    std::string   name;
+    std::function<void(void)> setup;        // not timed
+    std::function<void(void)> op;           // one iteration
+    std::function<void(void)> teardown;
+    int           items;                    // handled per iteration, for a rate. 0 for none
+};
+
+static std::vector<Benchmark> benchmarks;
+
+static void add(const std::string &name, std::function<void(void)> setup, std::function<void(void)> op,
+                std::function<void(void)> teardown = std::function<void(void)>(), int items = 0) {
+    benchmarks.push_back(Benchmark { name, setup, op, teardown, items });
+}
+
+static void run(const Benchmark &b, double minTime) {
+    if (b.setup)
+        b.setup();
+    b.op();     // warm up, so first-time allocations don't count
+
+    uint64_t iterations = 1, ns = 0, allocs = 0, bytes = 0;
+    int64_t peak = 0;
+    for (;;) {
+        uint64_t allocs0 = wchost::heap.allocs, bytes0 = wchost::heap.allocBytes;
+        uint64_t start = wchost::wallNanos();
+        wchost::trackHeap(true);
+        for (uint64_t i = 0; i < iterations; i++) {
+            // the high-water mark from where this iteration starts, without moving what ESP.getFreeHeap() sees
+            int64_t live = wchost::heap.live;
+            wchost::heap.peak = live;
+            b.op();
+            if (wchost::heap.peak - live > peak)
+                peak = wchost::heap.peak - live;
+        }
+        wchost::trackHeap(false);
+        ns = wchost::wallNanos() - start;
+        allocs = wchost::heap.allocs - allocs0;
+        bytes = wchost::heap.allocBytes - bytes0;
+        if (ns >= minTime * 1e9 || iterations >= 1000000000ULL)
+            break;
+        // aim a little past the target, never more than 100x at once
+        double scale = ns > 0 ? minTime * 1e9 * 1.4 / ns : 100;
+        iterations = (uint64_t)(iterations * (scale < 100 ? (scale > 2 ? scale : 2) : 100));
+    }
+
+    if (b.teardown)
+        b.teardown();
+    printf("%-36s %10.0f ns %12llu %11.2f %11.1f %10lld", b.name.c_str(), (double)ns / iterations,
+           (unsigned long long)iterations, (double)allocs / iterations, (double)bytes / iterations, (long long)peak);
+    if (b.items != 0)
+        printf(" %10.3fM/s", b.items * iterations / (ns / 1e9) / 1e6);
+    printf("\n");
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    const char *filter = "";
+    double minTime = 0.2;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--filter=", 9) == 0)
+            filter = argv[i] + 9;
+        else if (strncmp(argv[i], "--min-time=", 11) == 0)
+            minTime = atof(argv[i] + 11);
+        else {
+            fprintf(stderr, "usage: %s [--filter=<substring>] [--min-time=<seconds>]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::unique_ptr<Portal> portal;
+    std::string body;
+
+    /* pages, rendered as they're streamed out */
+    static const int PARAM_COUNTS[] = { 0, 10, WCBENCH_MAX_PARAMS };
+    for (int count : PARAM_COUNTS) {
+        std::string suffix = "/params:" + std::to_string(count);
+        add("root_page" + suffix, [&portal, count] { portal.reset(new Portal(count)); },
+            [] { exchange(HTTP_GET, "/"); }, [&portal] { portal.reset(); });
+        add("root_page_first_byte" + suffix, [&portal, count] { portal.reset(new Portal(count)); },
+            [] { firstSegment("/"); }, [&portal] { portal.reset(); });
+        add("root_page_cached" + suffix, [&portal, count] { portal.reset(new Portal(count, 8192)); },
+            [] { exchange(HTTP_GET, "/"); }, [&portal] { portal.reset(); });
+        add("config_schema" + suffix, [&portal, count] { portal.reset(new Portal(count)); },
+            [] { exchange(HTTP_GET, "/api/config"); }, [&portal] { portal.reset(); });
+        // each save is committed by config_loop before the next, so the staging ring never fills
+        add("wifisave_form" + suffix, [&portal, &body, count] { portal.reset(new Portal(count)); body = formBody(count); },
+            [&portal, &body] {
+                exchange(HTTP_POST, "/wifisave", WC_FORM_CONTENT_TYPE, body.c_str());
+                portal->wc.config_loop();
+            },
+            [&portal] { portal.reset(); });
+        add("config_upload" + suffix, [&portal, &body, count] { portal.reset(new Portal(count)); body = jsonBody(count); },
+            [&portal, &body] {
+                exchange(HTTP_POST, "/api/config", "application/json", body.c_str());
+                portal->wc.config_loop();
+            },
+            [&portal] { portal.reset(); });
+    }
+    add("info_page", [&portal] { portal.reset(new Portal(10)); }, [] { exchange(HTTP_GET, "/i"); },
+        [&portal] { portal.reset(); });
+    add("scan_json/networks:10", [&portal] { portal.reset(new Portal(0)); }, [] { exchange(HTTP_GET, "/scan"); },
+        [&portal] { portal.reset(); });
+    add("probe_redirect", [&portal] { portal.reset(new Portal(0)); }, [] { exchange(HTTP_GET, "/generate_204"); },
+        [&portal] { portal.reset(); });
+    add("asset_script", [&portal] { portal.reset(new Portal(0)); }, [] { exchange(HTTP_GET, "/s.js"); },
+        [&portal] { portal.reset(); });
+
+    /* the portal's own loop with nothing to do, which is most of its life */
+    add("config_loop/idle", [&portal] { portal.reset(new Portal(10)); }, [&portal] { portal->wc.config_loop(); },
+        [&portal] { portal.reset(); });
+    add("config_loop/idle_ms", [&portal] { portal.reset(new Portal(10)); },
+        [&portal] {
+            unsigned long idle;
+            portal->wc.config_loop(&idle);
+        },
+        [&portal] { portal.reset(); });
+
+    /* the pieces on their own */
+    std::unique_ptr<WIFIConfigDNS> dns;
+    wchost::Datagram query = { IPAddress(192, 168, 4, 2), 5353, wchost::dnsQuery(0x1234, "connectivitycheck.gstatic.com") };
+    add("dns_answer/batch:8",
+        [&dns] { dns.reset(new WIFIConfigDNS()); dns->start(53, IPAddress(192, 168, 4, 1)); },
+        [&dns, &query] {
+            for (int i = 0; i < WC_DNS_BUDGET; i++)
+                wchost::udpSend(53, query);
+            dns->processRequests();
+            wchost::Datagram answer;
+            while (wchost::udpReceive(&answer))
+                ;
+        },
+        [&dns] { dns.reset(); }, WC_DNS_BUDGET);
+    // the same batch through the core's DNSServer, one query per processNextRequest() as sketches call it
+    std::unique_ptr<DNSServer> coreDNS;
+    add("dns_answer_dnsserver/batch:8",
+        [&coreDNS] { coreDNS.reset(new DNSServer()); coreDNS->start(53, "*", IPAddress(192, 168, 4, 1)); },
+        [&coreDNS, &query] {
+            for (int i = 0; i < WC_DNS_BUDGET; i++)
+                wchost::udpSend(53, query);
+            for (int i = 0; i < WC_DNS_BUDGET; i++)
+                coreDNS->processNextRequest();
+            wchost::Datagram answer;
+            while (wchost::udpReceive(&answer))
+                ;
+        },
+        [&coreDNS] { coreDNS.reset(); }, WC_DNS_BUDGET);
+
+    struct NullSink : public WCFieldSink {
+        char buf[WC_PASS_MAX_LEN + 1];
+        char *fieldBuffer(const char *, size_t, size_t *cap) override { *cap = WC_PASS_MAX_LEN; return buf; }
+    } sink;
+    std::string form = formBody(10), json = jsonBody(10);
+    add("form_parser/fields:12", std::function<void(void)>(), [&sink, &form] {
+        WCFormParser parser;
+        parser.begin(&sink);
+        parser.parse((const uint8_t *)form.data(), form.size());
+        parser.finish();
+    });
+    add("json_parser/fields:12", std::function<void(void)>(), [&sink, &json] {
+        WCJSONParser parser;
+        parser.begin(&sink);
+        parser.parse((const uint8_t *)json.data(), json.size());
+        parser.finish();
+    });
+    add("split_template", std::function<void(void)>(), [] {
+        WCSegment segs[WIFICONFIG_HEAD_SEGMENTS];
+        wc_split_template("<style>h1{color:red}</style><meta name='t' content='{v}'><b>{v}</b>", "v",
+                          segs, WIFICONFIG_HEAD_SEGMENTS);
+    });
+
+    printf("%-36s %13s %12s %11s %11s %10s %12s\n", "Benchmark", "Time", "Iterations", "allocs/op", "bytes/op",
+           "peak B", "items/s");
+    printf("------------------------------------------------------------------------------------------------------------------\n");
+    for (size_t i = 0; i < benchmarks.size(); i++) {
+        if (strstr(benchmarks[i].name.c_str(), filter) != NULL)
+            run(benchmarks[i], minTime);
+    }
+    return 0;
+}
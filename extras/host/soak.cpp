@@ -0,0 +1,697 @@
+/**************************************************************
+   Soak test for WIFIConfig, on the host build.
+   Runs the whole portal, startConfigPortal() to WIFICONFIG_COMPLETE and
+   cleanup, under a crowd of simulated clients: phones that join the AP,
+   look up a probe host, hit their OS's probe URL, load the page and its
+   assets, hold /events open, scan, and eventually one of them saves.
+   The clock is simulated in 1ms ticks, each connection gets one segment
+   out per tick, so everything but the wall times is deterministic.
+
+   Per scenario it reports response and DNS answer latencies (simulated
+   ms), peak heap and allocations, and fails on a regression past the
+   baseline file, on any request failing, or on anything left allocated.
+   restart_cycles brings the one portal up and down a few hundred times,
+   and fails if the heap or the count of live blocks isn't back where it
+   started after any one of them.
+     wc_soak [--baseline=<file>] [--update-baseline] [--filter=<substring>]
+ **************************************************************/
+
+#include <wificonfig.h>
+#include "wchost.h"
+#include <algorithm>
+#include <climits>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+
+#define SOAK_HTTP_PORT      80
+#define SOAK_DNS_PORT       53
+#define SOAK_DNS_TIMEOUT    1000        // a phone asks again after this
+#define SOAK_RETRY_MS       1000        // what the portal's Retry-After asks for
+#define SOAK_MSS            536         // lwIP's default on the ESP8266, one segment per connection per tick
+#define SOAK_SLOTS          3           // requests a phone has going at once, besides /events
+#define SOAK_MAX_MS         120000      // a scenario that hasn't finished by now has hung
+
+/* what regresses: latencies by a quarter plus a couple of ticks, everything counted by 5% */
+#define SOAK_MS_TOLERANCE   0.25
+#define SOAK_MS_SLACK       2
+#define SOAK_TOLERANCE      0.05
+
+static const wchost::Network NETWORKS[] = {
+    { "HomeNet", -48, true }, { "Office-5G", -61, true }, { "CoffeeShop", -70, false },
+    { "Neighbour's <wifi>", -74, true }, { "Printer-Direct", -80, false }, { "Guest", -66, false },
+    { "IoT", -55, true }, { "Lab & Co", -83, true }, { "Mesh-2", -59, true }, { "FreeWiFi", -90, false },
+};
+
+// what each kind of phone looks up and fetches to decide it's behind a portal
+static const struct {
+    const char   *host;
+    const char   *path;
+} PROBES[] = {
+    { "connectivitycheck.gstatic.com",  "/generate_204" },          // Android
+    { "captive.apple.com",              "/hotspot-detect.html" },   // Apple
+    { "www.msftconnecttest.com",        "/connecttest.txt" },       // Windows
+    { "detectportal.firefox.com",       "/canonical.html" },        // Firefox
+};
+
+static const char SAVE_FORM[] = "s=HomeNet&p=correct+horse+battery&user=alice&pwd=s3cret&server=mqtt.example.com";
+static const char SAVE_JSON_WRONG[] = "{\"s\":\"HomeNet\",\"p\":\"wrong horse\",\"user\":\"alice\",\"pwd\":\"s3cret\",\"server\":\"mqtt.example.com\"}";
+static const char SAVE_JSON[] = "{\"s\":\"HomeNet\",\"p\":\"correct horse battery\",\"user\":\"alice\",\"pwd\":\"s3cret\",\"server\":\"mqtt.example.com\"}";
+
+/* deterministic jitter, reseeded per scenario */
+static uint32_t seed;
+
+static unsigned long jitter(unsigned long range) {
+    seed = seed * 1664525u + 1013904223u;
+    return range != 0 ? (seed >> 8) % range : 0;
+}
+
+/** What a scenario measures */
+class Run {
+  public:
+    Run() {
+        wchost::HeapPause pause;
+        httpMs.reserve(4096);
+        dnsMs.reserve(4096);
+    }
+
+    std::vector<unsigned long> httpMs;
+    std::vector<unsigned long> dnsMs;
+    uint32_t      requests = 0;
+    uint32_t      retries = 0;
+    uint32_t      dnsRetries = 0;
+    uint32_t      events = 0;
+    std::vector<std::string> failures;
+
+    void          fail(int phone, const char *what, const char *url, int code) {
+        wchost::HeapPause pause;
+        char line[160];
+        if (phone < 0)
+            snprintf(line, sizeof(line), "%s %s (%d)", what, url, code);
+        else
+            snprintf(line, sizeof(line), "phone %d: %s %s (%d)", phone, what, url, code);
+        failures.push_back(line);
+    }
+    void          sample(std::vector<unsigned long> &v, unsigned long ms) {
+        wchost::HeapPause pause;
+        v.push_back(ms);
+    }
+};
+
+/** A simulated client: a script of steps, run one at a time */
+enum {
+    STEP_THINK,         // wait 'ms', plus up to 'jitter' more
+    STEP_DNS,           // look up 'url' and wait for the answer
+    STEP_FETCH,         // a request, waited on if 'wait' is set, alongside the others otherwise
+    STEP_EVENTS,        // open /events and hold it
+    STEP_CALL,          // something on the harness side
+    STEP_REPEAT,        // back to step 'ms'
+};
+
+struct Step {
+    uint8_t       kind;
+    const char   *url;
+    unsigned long ms;
+    unsigned long jitter;
+    WebRequestMethod method;
+    int           expect;
+    const char   *type;
+    const char   *body;
+    bool          wait;
+    std::function<void(void)> call;
+};
+
+typedef std::vector<Step> Script;
+
+static Step think(unsigned long ms, unsigned long range = 0) {
+    return Step { STEP_THINK, NULL, ms, range, HTTP_GET, 0, NULL, NULL, false, nullptr };
+}
+static Step lookup(const char *host) {
+    return Step { STEP_DNS, host, 0, 0, HTTP_GET, 0, NULL, NULL, false, nullptr };
+}
+static Step get(const char *url, int expect = 200, bool wait = true) {
+    return Step { STEP_FETCH, url, 0, 0, HTTP_GET, expect, NULL, NULL, wait, nullptr };
+}
+static Step post(const char *url, const char *type, const char *body) {
+    return Step { STEP_FETCH, url, 0, 0, HTTP_POST, 200, type, body, true, nullptr };
+}
+static Step events(void) {
+    return Step { STEP_EVENTS, "/events", 0, 0, HTTP_GET, 0, NULL, NULL, false, nullptr };
+}
+static Step call(std::function<void(void)> fn) {
+    return Step { STEP_CALL, NULL, 0, 0, HTTP_GET, 0, NULL, NULL, false, fn };
+}
+static Step repeat(size_t from) {
+    return Step { STEP_REPEAT, NULL, from, 0, HTTP_GET, 0, NULL, NULL, false, nullptr };
+}
+
+class Phone {
+  public:
+    Phone(int index, Run *run, const Script &script) : _index(index), _run(run), _script(script) {
+        _ip = IPAddress(192, 168, 4, 10 + index);
+    }
+
+    bool          done(void) const { return _done; }
+
+    // once a tick
+    void tick(void) {
+        for (int i = 0; i < SOAK_SLOTS; i++)
+            service(_slots[i]);
+        _events.pump(SOAK_MSS);
+        if (_done || !_joined)
+            return;
+
+        unsigned long now = millis();
+        if (_dnsPending) {
+            if (now - _dnsSent < SOAK_DNS_TIMEOUT)
+                return;
+            _run->dnsRetries++;
+            sendQuery();
+            return;
+        }
+        if (now < _wakeAt || (_waiting && busy()))
+            return;
+        _waiting = false;
+
+        while (!_done && _pc < _script.size()) {
+            const Step &s = _script[_pc++];
+            switch (s.kind) {
+                case STEP_THINK:
+                    _wakeAt = now + s.ms + jitter(s.jitter);
+                    return;
+                case STEP_DNS:
+                    _host = s.url;
+                    sendQuery();
+                    return;
+                case STEP_FETCH:
+                    if (!start(s))
+                        return;
+                    if (s.wait) {
+                        _waiting = true;
+                        return;
+                    }
+                    break;
+                case STEP_EVENTS:
+                    if (_events.open(_ip, SOAK_HTTP_PORT))
+                        _events.request(HTTP_GET, s.url);
+                    break;
+                case STEP_CALL:
+                    s.call();
+                    break;
+                case STEP_REPEAT:
+                    _pc = s.ms;
+                    break;
+            }
+        }
+        if (_pc >= _script.size())
+            leave();
+    }
+
+    void join(void) {
+        _joined = true;
+        wchost::stationJoined(_index + 1);
+    }
+
+    // a DNS answer addressed to this phone
+    void answer(const wchost::Datagram &d) {
+        if (!_dnsPending || d.data.size() < 2 || (d.data[0] << 8 | d.data[1]) != _dnsId)
+            return;
+        _dnsPending = false;
+        _answered = true;
+        _run->sample(_run->dnsMs, millis() - _dnsStart);
+    }
+
+    const IPAddress &ip(void) const { return _ip; }
+
+  private:
+    struct Slot {
+        wchost::Connection conn;
+        const Step   *step = NULL;
+        unsigned long start = 0;        // the first attempt
+        unsigned long retryAt = 0;      // 0 unless waiting to try again
+    };
+
+    bool busy(void) const {
+        for (int i = 0; i < SOAK_SLOTS; i++) {
+            if (_slots[i].step != NULL)
+                return true;
+        }
+        return false;
+    }
+
+    bool start(const Step &s) {
+        for (int i = 0; i < SOAK_SLOTS; i++) {
+            if (_slots[i].step == NULL) {
+                _slots[i].step = &s;
+                _slots[i].start = millis();
+                return send(_slots[i]);
+            }
+        }
+        _run->fail(_index, "no free slot for", s.url, 0);
+        return false;
+    }
+
+    // false once the portal's gone, which is where a phone gives up
+    bool send(Slot &slot) {
+        slot.retryAt = 0;
+        slot.conn.keepBody = false;
+        if (!slot.conn.open(_ip, SOAK_HTTP_PORT)) {
+            slot.step = NULL;
+            leave();
+            return false;
+        }
+        slot.conn.request(slot.step->method, slot.step->url, slot.step->type, slot.step->body);
+        return true;
+    }
+
+    void service(Slot &slot) {
+        if (slot.step == NULL)
+            return;
+        if (slot.retryAt != 0) {
+            if (millis() >= slot.retryAt)
+                send(slot);
+            return;
+        }
+        if (slot.conn.pump(SOAK_MSS))
+            return;
+
+        const Step *s = slot.step;
+        if (slot.conn.code == 429 || slot.conn.code == 503) {
+            _run->retries++;
+            slot.retryAt = millis() + SOAK_RETRY_MS;
+            return;
+        }
+        slot.step = NULL;
+        _run->requests++;
+        if (slot.conn.code != s->expect)
+            _run->fail(_index, "unexpected response to", s->url, slot.conn.code);
+        else
+            _run->sample(_run->httpMs, millis() - slot.start);
+    }
+
+    void sendQuery(void) {
+        if (!_dnsPending) {
+            _dnsStart = millis();
+            _dnsId = jitter(0x10000);
+        }
+        _dnsPending = true;
+        _dnsSent = millis();
+        wchost::Datagram d;
+        {
+            wchost::HeapPause pause;
+            d = wchost::Datagram { _ip, (uint16_t)(40000 + _index), wchost::dnsQuery(_dnsId, _host) };
+        }
+        // nobody listening: either the portal's not up yet, and the query's lost, or it's gone
+        if (!wchost::udpSend(SOAK_DNS_PORT, d) && _answered) {
+            _dnsPending = false;
+            leave();
+        }
+        wchost::HeapPause pause;
+        d.data.clear();
+        d.data.shrink_to_fit();
+    }
+
+    // the phone drops off the AP, hanging up whatever it still has open
+    void leave(void) {
+        if (_done)
+            return;
+        _done = true;
+        for (int i = 0; i < SOAK_SLOTS; i++) {
+            _slots[i].conn.close();
+            _slots[i].step = NULL;
+        }
+        _run->events += _events.events;
+        _events.close();
+        wchost::stationLeft(_index + 1);
+    }
+
+    int           _index;
+    Run          *_run;
+    const Script &_script;
+    IPAddress     _ip;
+    bool          _joined = false;
+    bool          _done = false;
+    size_t        _pc = 0;
+    bool          _waiting = false;
+    unsigned long _wakeAt = 0;
+    Slot          _slots[SOAK_SLOTS];
+    wchost::Connection _events;
+
+    const char   *_host = NULL;
+    bool          _dnsPending = false;
+    bool          _answered = false;         // the portal's DNS has been heard from
+    uint16_t      _dnsId = 0;
+    unsigned long _dnsStart = 0;
+    unsigned long _dnsSent = 0;
+};
+
+/** Scenarios */
+struct Scenario {
+    const char   *name;
+    int           phones;
+    unsigned long joinSpread;       // phones join evenly over this long
+    size_t        pageCache;
+    unsigned long connectCheck;     // seconds, 0 for none
+    int           cycles;           // startConfigPortal() to WIFICONFIG_COMPLETE, this many times on the one instance
+    // builds phone i's script, 'scripts' outlives the run
+    std::function<void(int i, Script &script)> script;
+    // anything to set up on the radio before the portal starts
+    std::function<void(void)> before;
+};
+
+// a phone's browser: probe, tap the notification, the page and what it pulls in, then re-probing now and then
+static void browse(int i, Script &s) {
+    const char *host = PROBES[i % WC_ARRAY_LEN(PROBES)].host, *path = PROBES[i % WC_ARRAY_LEN(PROBES)].path;
+    s.push_back(lookup(host));
+    s.push_back(get(path, 302));
+    s.push_back(think(400, 600));
+    s.push_back(get("/"));
+    s.push_back(get("/s.css", 200, false));
+    s.push_back(get("/s.js", 200, true));
+    s.push_back(events());
+    s.push_back(get("/scan"));
+    s.push_back(think(1000, 2000));
+    s.push_back(get("/i"));
+}
+
+static void reprobe(int i, Script &s) {
+    size_t from = s.size();
+    s.push_back(think(2000, 1000));
+    s.push_back(lookup(PROBES[i % WC_ARRAY_LEN(PROBES)].host));
+    s.push_back(get(PROBES[i % WC_ARRAY_LEN(PROBES)].path, 302));
+    s.push_back(repeat(from));
+}
+
+#define STORM_OWNER     7
+
+static void stormPhone(int i, Script &s) {
+    browse(i, s);
+    if (i == STORM_OWNER) {
+        s.push_back(think(1500));
+        s.push_back(post("/wifisave", WC_FORM_CONTENT_TYPE, SAVE_FORM));
+    }
+    reprobe(i, s);
+}
+
+// an app provisioning over the API: a wrong passkey first, fixed once the status comes back
+static void appClient(int i, Script &s) {
+    s.push_back(think(200, 300));
+    s.push_back(get("/api/config"));
+    s.push_back(events());
+    if (i == 0) {
+        s.push_back(think(500));
+        s.push_back(post("/api/config", "application/json", SAVE_JSON_WRONG));
+        s.push_back(think(3000));
+        s.push_back(call([] { wchost::setConnectResult(WL_CONNECTED, 1500); }));
+        s.push_back(post("/api/config", "application/json", SAVE_JSON));
+    }
+    size_t from = s.size();
+    s.push_back(think(1500, 500));
+    s.push_back(get("/api/config"));
+    s.push_back(repeat(from));
+}
+
+// a short visit, saved straight away: the portal coming up and going again is what's being exercised
+static void quickSave(int i, Script &s) {
+    s.push_back(lookup(PROBES[i % WC_ARRAY_LEN(PROBES)].host));
+    s.push_back(get(PROBES[i % WC_ARRAY_LEN(PROBES)].path, 302));
+    s.push_back(get("/"));
+    s.push_back(events());
+    if (i == 0) {
+        s.push_back(think(200, 100));
+        s.push_back(post("/wifisave", WC_FORM_CONTENT_TYPE, SAVE_FORM));
+    }
+    reprobe(i, s);
+}
+
+static const Scenario SCENARIOS[] = {
+    { "phone_storm", 32, 500, 0, 15, 1, stormPhone, [] { wchost::setConnectResult(WL_CONNECTED, 3000); } },
+    { "phone_storm_cached", 32, 500, 8192, 15, 1, stormPhone, [] { wchost::setConnectResult(WL_CONNECTED, 3000); } },
+    { "provisioning_app", 6, 300, 0, 10, 1, appClient, [] { wchost::setConnectResult(WL_CONNECT_FAILED, 2000); } },
+    // the heap and the block count are checked after every cycle, not just at the end
+    { "restart_cycles", 3, 100, 2048, 5, 300, quickSave, [] { wchost::setConnectResult(WL_CONNECTED, 300); } },
+};
+
+/** Results */
+typedef std::vector<std::pair<std::string, double>> Metrics;
+
+static unsigned long percentile(std::vector<unsigned long> v, int p) {
+    if (v.empty())
+        return 0;
+    std::sort(v.begin(), v.end());
+    size_t rank = (v.size() * p + 99) / 100;
+    return v[rank > 0 ? rank - 1 : 0];
+}
+
+static bool saved;
+
+static void onSave(void) {
+    saved = true;
+}
+
+// runs one scenario, false if it failed outright
+static bool runScenario(const Scenario &sc, Metrics &metrics) {
+    Run run;
+    std::vector<Script> scripts(sc.phones);
+    for (int i = 0; i < sc.phones; i++)
+        sc.script(i, scripts[i]);
+
+    seed = 12345;
+    uint8_t state = WIFICONFIG_INPROGRESS;
+    unsigned long completeMs = 0;
+    uint64_t loopNs = 0, loops = 0, wallStart = wchost::wallNanos();
+    uint64_t allocs0 = wchost::heap.allocs, bytes0 = wchost::heap.allocBytes;
+    int64_t retained, peak;
+
+    wchost::resetPeak();
+    wchost::trackHeap(true);
+    {
+        char user[51], pwd[51], server[31] = "defaultServer.com";
+        WIFIConfigParam userParam("user", "Username");
+        WIFIConfigParam pwdParam("pwd", "Password", "type='password'");
+        WIFIConfigParam serverParam("server", "Server (Optional)");
+
+        WIFIConfig wc("The Portal");
+        wc.setConfigPortalTimeout(120);
+        wc.setConnectCheck(sc.connectCheck);
+        wc.setPageCacheSize(sc.pageCache);
+        wc.setSaveConfigCallback(onSave);
+        wc.addParameter(&userParam, user, sizeof(user) - 1);
+        wc.addParameter(&pwdParam, pwd, sizeof(pwd) - 1);
+        wc.addParameter(&serverParam, server, sizeof(server) - 1, true);
+
+        // everything a cycle allocates should be gone again by the end of it
+        int64_t live0 = wchost::heap.live, blocks0 = wchost::heap.blocks;
+        for (int cycle = 0; cycle < sc.cycles && run.failures.empty(); cycle++) {
+            std::vector<std::unique_ptr<Phone>> phones;
+            {
+                wchost::HeapPause pause;
+                for (int i = 0; i < sc.phones; i++)
+                    phones.emplace_back(new Phone(i, &run, scripts[i]));
+            }
+            saved = false;
+            user[0] = '\0';
+            strcpy(server, "defaultServer.com");
+            wchost::setScanResults(NETWORKS, WC_ARRAY_LEN(NETWORKS));
+            if (sc.before)
+                sc.before();
+
+            state = WIFICONFIG_INPROGRESS;
+            unsigned long began = millis();
+            if (!wc.startConfigPortal("TestAP", "12345678"))
+                run.fail(-1, "couldn't start", "the portal", cycle);
+
+            int joined = 0;
+            while (run.failures.empty()) {
+                unsigned long now = millis() - began;
+                if (now > SOAK_MAX_MS) {
+                    run.fail(-1, "hung", "in config_loop", state);
+                    break;
+                }
+                while (joined < sc.phones && now >= sc.joinSpread * joined / sc.phones)
+                    phones[joined++]->join();
+
+                unsigned long idle;
+                uint64_t t0 = wchost::wallNanos();
+                uint8_t was = state;
+                state = wc.config_loop(&idle);
+                loopNs += wchost::wallNanos() - t0;
+                loops++;
+                // the slowest cycle's
+                if (was == WIFICONFIG_INPROGRESS && state != WIFICONFIG_INPROGRESS && now > completeMs)
+                    completeMs = now;
+
+                wchost::Datagram d;
+                while (wchost::udpReceive(&d)) {
+                    for (size_t i = 0; i < phones.size(); i++) {
+                        if (phones[i]->ip() == d.ip)
+                            phones[i]->answer(d);
+                    }
+                }
+                bool left = true;
+                for (size_t i = 0; i < phones.size(); i++) {
+                    phones[i]->tick();
+                    left = left && phones[i]->done();
+                }
+                // the portal's closed, everyone's gone and the server's been let go
+                if (state != WIFICONFIG_INPROGRESS && left && idle == ULONG_MAX)
+                    break;
+                wchost::advance(1);
+            }
+            if (!run.failures.empty())
+                break;
+
+            // what was saved is what was sent
+            char ssid[WC_SSID_MAX_LEN + 1];
+            if (state != WIFICONFIG_COMPLETE)
+                run.fail(-1, "didn't complete,", "config_loop returned", state);
+            else if (!wc.get_wifi_ssid(ssid, sizeof(ssid)) || strcmp(ssid, "HomeNet") != 0
+                     || strcmp(user, "alice") != 0 || strcmp(server, "mqtt.example.com") != 0)
+                run.fail(-1, "saved the wrong", "values", cycle);
+            if (!saved)
+                run.fail(-1, "no save", "callback", cycle);
+            if (wchost::heap.live != live0)
+                run.fail(-1, "bytes left allocated after", "a cycle", (int)(wchost::heap.live - live0));
+            if (wchost::heap.blocks != blocks0)
+                run.fail(-1, "blocks left allocated after", "a cycle", (int)(wchost::heap.blocks - blocks0));
+            if (!run.failures.empty() && sc.cycles > 1)
+                run.fail(-1, "on", "cycle", cycle);
+        }
+    }
+    wchost::trackHeap(false);
+    retained = wchost::heap.live - wchost::heap.base;
+    peak = wchost::heap.peak - wchost::heap.base;
+
+    // the rest is the harness's, percentile() copies the samples
+    wchost::HeapPause pause;
+    if (retained != 0)
+        run.fail(-1, "bytes left allocated after", "cleanup", (int)retained);
+    if (peak > WCHOST_HEAP_SIZE)
+        run.fail(-1, "ran past the simulated heap,", "peak", (int)peak);
+
+    metrics.push_back({ "requests", run.requests });
+    metrics.push_back({ "retries", run.retries });
+    metrics.push_back({ "http_p50_ms", percentile(run.httpMs, 50) });
+    metrics.push_back({ "http_p99_ms", percentile(run.httpMs, 99) });
+    metrics.push_back({ "dns_answers", run.dnsMs.size() });
+    metrics.push_back({ "dns_retries", run.dnsRetries });
+    metrics.push_back({ "dns_p50_ms", percentile(run.dnsMs, 50) });
+    metrics.push_back({ "dns_p99_ms", percentile(run.dnsMs, 99) });
+    metrics.push_back({ "complete_ms", completeMs });
+    metrics.push_back({ "sse_events", run.events });
+    metrics.push_back({ "peak_heap", peak });
+    metrics.push_back({ "allocs", wchost::heap.allocs - allocs0 });
+    metrics.push_back({ "alloc_bytes", wchost::heap.allocBytes - bytes0 });
+
+    printf("%s: %d phones, %d cycle%s, complete at %lums, %.1f ms wall, %.0f ns per config_loop (wall, not checked)\n",
+           sc.name, sc.phones, sc.cycles, sc.cycles != 1 ? "s" : "", completeMs, (wchost::wallNanos() - wallStart) / 1e6,
+           loops ? (double)loopNs / loops : 0.0);
+    for (size_t i = 0; i < run.failures.size(); i++)
+        printf("  FAIL %s\n", run.failures[i].c_str());
+    return run.failures.empty();
+}
+
+/** Baseline */
+typedef std::map<std::string, double> Baseline;
+
+static bool loadBaseline(const char *path, Baseline &base) {
+    std::ifstream in(path);
+    if (!in)
+        return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream fields(line);
+        std::string scenario, metric;
+        double value;
+        if (fields >> scenario >> metric >> value)
+            base[scenario + " " + metric] = value;
+    }
+    return true;
+}
+
+static bool isLatency(const std::string &metric) {
+    return metric.size() > 3 && metric.compare(metric.size() - 3, 3, "_ms") == 0;
+}
+
+// false if 'value' has regressed past what 'base' allows
+static bool withinBaseline(const std::string &metric, double value, double base, double *limit) {
+    if (isLatency(metric))
+        *limit = base * (1 + SOAK_MS_TOLERANCE) + SOAK_MS_SLACK;
+    else
+        *limit = std::max(base * (1 + SOAK_TOLERANCE), base + 1);
+    return value <= *limit;
+}
+
+int main(int argc, char **argv) {
+    const char *baselinePath = NULL, *filter = "";
+    bool update = false;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--baseline=", 11) == 0)
+            baselinePath = argv[i] + 11;
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+            baselinePath = argv[++i];
+        else if (strcmp(argv[i], "--update-baseline") == 0)
+            update = true;
+        else if (strncmp(argv[i], "--filter=", 9) == 0)
+            filter = argv[i] + 9;
+        else {
+            fprintf(stderr, "usage: %s [--baseline=<file>] [--update-baseline] [--filter=<substring>]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (update && baselinePath == NULL) {
+        fprintf(stderr, "--update-baseline needs --baseline=<file>\n");
+        return 2;
+    }
+
+    Baseline base;
+    if (baselinePath != NULL && !update && !loadBaseline(baselinePath, base)) {
+        fprintf(stderr, "can't read the baseline %s\n", baselinePath);
+        return 2;
+    }
+
+    bool ok = true;
+    std::string out = "# wc_soak baseline: <scenario> <metric> <value>, regenerate with --update-baseline\n";
+    for (size_t s = 0; s < WC_ARRAY_LEN(SCENARIOS); s++) {
+        const Scenario &sc = SCENARIOS[s];
+        if (strstr(sc.name, filter) == NULL)
+            continue;
+        Metrics metrics;
+        ok = runScenario(sc, metrics) && ok;
+
+        for (size_t i = 0; i < metrics.size(); i++) {
+            const std::string &metric = metrics[i].first;
+            double value = metrics[i].second, limit;
+            char line[128];
+            snprintf(line, sizeof(line), "%s %s %.0f\n", sc.name, metric.c_str(), value);
+            out += line;
+
+            auto it = base.find(std::string(sc.name) + " " + metric);
+            if (update || baselinePath == NULL) {
+                printf("  %-14s %10.0f\n", metric.c_str(), value);
+            } else if (it == base.end()) {
+                printf("  %-14s %10.0f   (no baseline)\n", metric.c_str(), value);
+            } else if (!withinBaseline(metric, value, it->second, &limit)) {
+                printf("  %-14s %10.0f   REGRESSED, baseline %.0f, limit %.0f\n", metric.c_str(), value, it->second, limit);
+                ok = false;
+            } else {
+                printf("  %-14s %10.0f   baseline %.0f\n", metric.c_str(), value, it->second);
+            }
+        }
+    }
+
+    if (update) {
+        std::ofstream file(baselinePath);
+        file << out;
+        if (!file) {
+            fprintf(stderr, "can't write the baseline %s\n", baselinePath);
+            return 2;
+        }
+        printf("baseline written to %s\n", baselinePath);
+    }
+    printf(ok ? "PASS\n" : "FAIL\n");
+    return ok ? 0 : 1;
+}
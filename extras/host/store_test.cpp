@@ -0,0 +1,288 @@
+/**************************************************************
+   Tests for WIFIConfig's config store, on the host build with
+   WC_ENABLE_STORE, against the in-memory LittleFS in wchost.cpp.
+   Records have to rotate through the slots, a damaged or cut-short
+   record has to be passed over for the one in the other slot, and a
+   record saved with another parameter layout has to be left alone.
+     wc_store_test [--filter=<substring>]
+ **************************************************************/
+
+#include <wificonfig.h>
+#include "wchost.h"
+#include <LittleFS.h>
+#include <climits>
+#include <cstddef>
+
+static int failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("  FAIL line %d: %s\n", __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+/* the example's setup: a username and a server with a default, each in its own buffer */
+class Device {
+  public:
+    Device(int userLen = 50) : userParam("user", "Username"), serverParam("server", "Server (Optional)"), wc("The Portal") {
+        user[0] = '\0';
+        strcpy(server, "defaultServer.com");
+        wc.addParameter(&userParam, user, userLen);
+        wc.addParameter(&serverParam, server, sizeof(server) - 1, true);
+    }
+
+    // a config saved through the portal, which is the only way in for the SSID and passkey. It's stored as the portal completes
+    bool provision(const char *form) {
+        if (!wc.startConfigPortal("TestAP"))
+            return false;
+        for (int i = 0; i < 100; i++) {
+            wc.config_loop();
+            wchost::advance(10);
+        }
+        wchost::Connection c;
+        if (!c.open(IPAddress(192, 168, 4, 2)))
+            return false;
+        c.request(HTTP_POST, "/wifisave", WC_FORM_CONTENT_TYPE, form);
+        while (c.pump())
+            ;
+        uint8_t state = WIFICONFIG_INPROGRESS;
+        unsigned long idle = 0;
+        for (int i = 0; i < 10000 && (state == WIFICONFIG_INPROGRESS || idle != ULONG_MAX); i++) {
+            state = wc.config_loop(&idle);
+            wchost::advance(1);
+        }
+        return state == WIFICONFIG_COMPLETE;
+    }
+
+    bool has(const char *ssid, const char *pass, const char *u) {
+        char s[WC_SSID_MAX_LEN + 1], p[WC_PASS_MAX_LEN + 1];
+        return wc.get_wifi_ssid(s, WC_SSID_MAX_LEN) && strcmp(s, ssid) == 0 && wc.get_wifi_passkey(p, WC_PASS_MAX_LEN)
+               && strcmp(p, pass) == 0 && strcmp(user, u) == 0;
+    }
+
+    char          user[51];
+    char          server[31];
+    WIFIConfigParam userParam;
+    WIFIConfigParam serverParam;
+    WIFIConfig    wc;
+};
+
+static const char FORM[] = "s=HomeNet&p=correct+horse+battery&user=alice&server=mqtt.example.com";
+
+/* the slots as they are on flash */
+static std::vector<uint8_t> *slotFile(int slot) {
+    char path[16];
+    snprintf(path, sizeof(path), WC_STORE_PATH, slot);
+    return wchost::fsFile(path);
+}
+
+// the record's sequence number, 0 if the slot's empty
+static uint32_t slotSeq(int slot) {
+    std::vector<uint8_t> *f = slotFile(slot);
+    WCStoreHeader hdr;
+    if (f == NULL || f->size() < sizeof(hdr))
+        return 0;
+    memcpy(&hdr, f->data(), sizeof(hdr));
+    return hdr.seq;
+}
+
+/** Tests */
+static void saveAndLoad(void) {
+    Device a;
+    CHECK(a.provision(FORM));
+    CHECK(slotSeq(0) == 1);
+
+    Device b;
+    CHECK(b.wc.loadConfig());
+    CHECK(b.has("HomeNet", "correct horse battery", "alice"));
+    CHECK(strcmp(b.server, "mqtt.example.com") == 0);
+}
+
+// each save goes to the slot not holding the newest record, so the last good one's always still there
+static void slotRotation(void) {
+    Device a;
+    CHECK(a.provision(FORM));
+    for (uint32_t seq = 2; seq <= 6; seq++) {
+        snprintf(a.user, sizeof(a.user), "user%u", seq);
+        CHECK(a.wc.saveConfig());
+        CHECK(slotSeq((seq - 1) % WC_STORE_SLOTS) == seq);
+        CHECK(slotSeq(seq % WC_STORE_SLOTS) == seq - 1);
+    }
+
+    Device b;
+    CHECK(b.wc.loadConfig());
+    CHECK(b.has("HomeNet", "correct horse battery", "user6"));
+}
+
+static void badCRC(void) {
+    Device a;
+    CHECK(a.provision(FORM));
+    strcpy(a.user, "bob");
+    CHECK(a.wc.saveConfig());
+
+    // a bit flipped in the newest record's SSID
+    std::vector<uint8_t> *f = slotFile(1);
+    CHECK(f != NULL && f->size() > sizeof(WCStoreHeader));
+    if (f != NULL)
+        (*f)[sizeof(WCStoreHeader) + 2] ^= 0x04;
+    Device b;
+    CHECK(b.wc.loadConfig());
+    CHECK(b.has("HomeNet", "correct horse battery", "alice"));
+
+    // the next save takes the damaged slot, not the good one
+    strcpy(a.user, "carol");
+    CHECK(a.wc.saveConfig());
+    CHECK(slotSeq(0) == 1);
+    CHECK(slotSeq(1) == 2);
+    Device c;
+    CHECK(c.wc.loadConfig());
+    CHECK(c.has("HomeNet", "correct horse battery", "carol"));
+}
+
+// the power going partway through a save, anywhere from the header to the last byte, loses only that save
+static void tornWrite(void) {
+    Device a;
+    CHECK(a.provision(FORM));
+    strcpy(a.user, "bob");
+    CHECK(a.wc.saveConfig());
+    size_t record = slotFile(1) != NULL ? slotFile(1)->size() : 0;
+    CHECK(record > sizeof(WCStoreHeader));
+
+    const size_t cuts[] = { 0, offsetof(WCStoreHeader, crc), sizeof(WCStoreHeader), sizeof(WCStoreHeader) + 40, record - 1 };
+    for (size_t i = 0; i < WC_ARRAY_LEN(cuts); i++) {
+        strcpy(a.user, "carol");
+        wchost::fsCutPowerAfter(cuts[i]);
+        CHECK(!a.wc.saveConfig());
+        wchost::fsPowerOn();
+
+        Device b;
+        CHECK(b.wc.loadConfig());
+        CHECK(b.has("HomeNet", "correct horse battery", "bob"));
+        CHECK(slotSeq(1) == 2);
+    }
+
+    // and the one after goes through
+    CHECK(a.wc.saveConfig());
+    Device c;
+    CHECK(c.wc.loadConfig());
+    CHECK(c.has("HomeNet", "correct horse battery", "carol"));
+}
+
+// a record saved with other parameters, or other lengths, isn't read into these buffers
+static void schemaChange(void) {
+    Device a;
+    CHECK(a.provision(FORM));
+
+    Device b(40);
+    CHECK(!b.wc.loadConfig());
+    CHECK(b.user[0] == '\0' && strcmp(b.server, "defaultServer.com") == 0);
+    char ssid[WC_SSID_MAX_LEN + 1];
+    CHECK(!b.wc.get_wifi_ssid(ssid, WC_SSID_MAX_LEN));
+
+    Device c;
+    WIFIConfigParam extraParam("extra", "Extra");
+    char extra[11] = "";
+    c.wc.addParameter(&extraParam, extra, sizeof(extra) - 1);
+    CHECK(!c.wc.loadConfig());
+
+    // the new layout's record is newer, but a device still on the old one carries on with its own
+    CHECK(b.provision("s=OtherNet&p=another+passkey&user=dave&server=x"));
+    CHECK(slotSeq(1) == 2);
+    Device d;
+    CHECK(d.wc.loadConfig());
+    CHECK(d.has("HomeNet", "correct horse battery", "alice"));
+    Device e(40);
+    CHECK(e.wc.loadConfig());
+    CHECK(e.has("OtherNet", "another passkey", "dave"));
+}
+
+// whatever's wrong with the newest record, the other slot's is used, and with neither there's nothing to load
+static void fallback(void) {
+    Device a;
+    CHECK(a.provision(FORM));
+    strcpy(a.user, "bob");
+    CHECK(a.wc.saveConfig());
+
+    std::vector<uint8_t> *newest = slotFile(1), *older = slotFile(0);
+    CHECK(newest != NULL && older != NULL);
+    if (newest == NULL || older == NULL)
+        return;
+
+    // a header cut off
+    newest->resize(sizeof(WCStoreHeader) / 2);
+    Device b;
+    CHECK(b.wc.loadConfig());
+    CHECK(b.has("HomeNet", "correct horse battery", "alice"));
+
+    // a payload shorter than its header says
+    CHECK(a.wc.saveConfig());
+    newest->pop_back();
+    Device c;
+    CHECK(c.wc.loadConfig());
+    CHECK(c.has("HomeNet", "correct horse battery", "alice"));
+
+    // the file gone altogether
+    LittleFS.remove("/wcfg1.bin");
+    Device d;
+    CHECK(d.wc.loadConfig());
+    CHECK(d.has("HomeNet", "correct horse battery", "alice"));
+
+    // and the other one's magic damaged too
+    (*older)[0] ^= 0xFF;
+    Device e;
+    CHECK(!e.wc.loadConfig());
+    char ssid[WC_SSID_MAX_LEN + 1];
+    CHECK(!e.wc.get_wifi_ssid(ssid, WC_SSID_MAX_LEN));
+    CHECK(e.user[0] == '\0');
+
+    // erasing takes everything
+    CHECK(a.wc.saveConfig());
+    Device f;
+    CHECK(f.wc.loadConfig());
+    a.wc.eraseConfig();
+    CHECK(slotFile(0) == NULL && slotFile(1) == NULL);
+    Device g;
+    CHECK(!g.wc.loadConfig());
+}
+
+static const struct {
+    const char   *name;
+    void        (*run)(void);
+} TESTS[] = {
+    { "save_and_load", saveAndLoad },
+    { "slot_rotation", slotRotation },
+    { "bad_crc", badCRC },
+    { "torn_write", tornWrite },
+    { "schema_change", schemaChange },
+    { "fallback", fallback },
+};
+
+int main(int argc, char **argv) {
+    const char *filter = "";
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--filter=", 9) == 0)
+            filter = argv[i] + 9;
+        else {
+            fprintf(stderr, "usage: %s [--filter=<substring>]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    int failed = 0;
+    for (size_t i = 0; i < WC_ARRAY_LEN(TESTS); i++) {
+        if (strstr(TESTS[i].name, filter) == NULL)
+            continue;
+        // each on a freshly formatted filesystem
+        wchost::fsFormat();
+        wchost::fsPowerOn();
+        int before = failures;
+        TESTS[i].run();
+        printf("%-16s %s\n", TESTS[i].name, failures == before ? "ok" : "FAIL");
+        fflush(stdout);
+        if (failures != before)
+            failed++;
+    }
+    printf(failed == 0 ? "PASS\n" : "FAIL\n");
+    return failed == 0 ? 0 : 1;
+}
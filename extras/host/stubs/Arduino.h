@@ -0,0 +1,141 @@
+/**************************************************************
+   Host stand-in for the Arduino core, just what WIFIConfig uses.
+   Time is simulated: millis() only moves when the harness (or delay())
+   moves it, so a run is the same every time. See wchost.h.
+ **************************************************************/
+
+#ifndef WCHost_Arduino_h
+#define WCHost_Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <functional>
+#include <string>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define PROGMEM
+#define PGM_P               const char *
+#define PSTR(s)             (s)
+class __FlashStringHelper;
+#define FPSTR(p)            (reinterpret_cast<const __FlashStringHelper *>(p))
+#define F(s)                FPSTR(s)
+#define pgm_read_byte(a)    (*(const uint8_t *)(a))
+#define pgm_read_dword(a)   (*(const uint32_t *)(a))
+#define pgm_read_ptr(a)     (*(void * const *)(a))
+#define memcpy_P            memcpy
+#define strlen_P            strlen
+#define strcmp_P            strcmp
+#define strncmp_P           strncmp
+#define strncpy_P           strncpy
+#define strchr_P            strchr
+
+unsigned long millis(void);
+unsigned long micros(void);
+void          delay(unsigned long ms);
+void          yield(void);
+
+class String {
+  public:
+    String(const char *s = "") : _s(s != NULL ? s : "") {}
+    String(const __FlashStringHelper *s) : _s((const char *)s) {}
+    String(const std::string &s) : _s(s) {}
+    String(int n) : _s(std::to_string(n)) {}
+    String(unsigned int n) : _s(std::to_string(n)) {}
+    String(long n) : _s(std::to_string(n)) {}
+    String(unsigned long n) : _s(std::to_string(n)) {}
+
+    unsigned int  length(void) const { return _s.length(); }
+    const char   *c_str(void) const { return _s.c_str(); }
+    bool          reserve(unsigned int n) { _s.reserve(n); return true; }
+    bool          startsWith(const String &s) const { return _s.compare(0, s._s.length(), s._s) == 0; }
+    bool          equals(const String &s) const { return _s == s._s; }
+    bool          equalsIgnoreCase(const String &s) const { return strcasecmp(c_str(), s.c_str()) == 0; }
+    int           indexOf(char c) const { size_t i = _s.find(c); return i == std::string::npos ? -1 : (int)i; }
+    char          charAt(unsigned int i) const { return i < _s.length() ? _s[i] : 0; }
+    char          operator[](unsigned int i) const { return charAt(i); }
+    bool          operator==(const char *s) const { return _s == s; }
+    bool          operator==(const String &s) const { return _s == s._s; }
+    String       &operator+=(const String &s) { _s += s._s; return *this; }
+    String       &operator+=(const char *s) { _s += s; return *this; }
+    String       &operator+=(char c) { _s += c; return *this; }
+    void          toCharArray(char *buf, unsigned int len) const {
+        if (len == 0)
+            return;
+        strncpy(buf, c_str(), len - 1);
+        buf[len - 1] = 0;
+    }
+  private:
+    std::string   _s;
+};
+
+inline String operator+(const String &a, const String &b) { String s(a); s += b; return s; }
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buf, size_t len) {
+        size_t n = 0;
+        while (len-- > 0)
+            n += write(*buf++);
+        return n;
+    }
+    size_t        print(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+    size_t        print(const String &s) { return write((const uint8_t *)s.c_str(), s.length()); }
+    size_t        print(const __FlashStringHelper *s) { return print((const char *)s); }
+    size_t        print(unsigned long n, int base = 10) { return printf(base == 16 ? "%lx" : "%lu", n); }
+    size_t        print(int n, int base = 10) { return base == 16 ? printf("%x", n) : printf("%d", n); }
+    size_t        println(void) { return print("\r\n"); }
+    size_t        println(const char *s) { return print(s) + println(); }
+    size_t        println(const String &s) { return print(s) + println(); }
+    size_t        println(const __FlashStringHelper *s) { return print(s) + println(); }
+    size_t        println(unsigned long n, int base = 10) { return print(n, base) + println(); }
+    size_t        println(int n, int base = 10) { return print(n, base) + println(); }
+    size_t        printf(const char *fmt, ...) __attribute__((format(printf, 2, 3))) {
+        char buf[256];
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+        va_end(ap);
+        if (n < 0)
+            return 0;
+        return write((const uint8_t *)buf, (size_t)n < sizeof(buf) ? n : sizeof(buf) - 1);
+    }
+};
+
+class Stream : public Print {};
+
+// goes to stdout, and never holds anything up
+class HardwareSerial : public Stream {
+  public:
+    using Print::write;
+    size_t        write(uint8_t c) override;
+    int           availableForWrite(void) { return 256; }
+    void          begin(unsigned long) {}
+};
+extern HardwareSerial Serial;
+
+class IPAddress {
+  public:
+    IPAddress() : _addr(0) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _addr(a | b << 8 | c << 16 | (uint32_t)d << 24) {}
+    IPAddress(uint32_t addr) : _addr(addr) {}
+    operator uint32_t() const { return _addr; }
+    uint8_t       operator[](int i) const { return _addr >> (8 * i); }
+    bool          operator==(const IPAddress &ip) const { return _addr == ip._addr; }
+    String        toString(void) const {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+        return String(buf);
+    }
+  private:
+    uint32_t      _addr;
+};
+
+#endif
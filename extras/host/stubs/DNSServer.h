@@ -0,0 +1,55 @@
+/**************************************************************
+   Host stand-in for the ESP8266 core's DNSServer, the one sketches
+   used before WIFIConfigDNS, so the benchmarks can put the two side
+   by side. It's the core's own logic over the WiFiUDP stand-in: one
+   datagram per processNextRequest(), copied into a buffer allocated
+   for it, and an A record for any name when the domain is "*".
+ **************************************************************/
+
+#ifndef WCHost_DNSServer_h
+#define WCHost_DNSServer_h
+
+#include <Arduino.h>
+#include <WiFiUdp.h>
+
+#define MAX_DNS_PACKETSIZE      512
+#define DNS_HEADER_SIZE         12
+
+enum class DNSReplyCode {
+    NoError = 0,
+    FormError = 1,
+    ServerFailure = 2,
+    NonExistentDomain = 3,
+    NotImplemented = 4,
+    Refused = 5,
+};
+
+class DNSServer {
+  public:
+    DNSServer();
+    ~DNSServer() { stop(); }
+
+    void          processNextRequest(void);
+    void          setErrorReplyCode(const DNSReplyCode &replyCode) { _errorReplyCode = replyCode; }
+    void          setTTL(const uint32_t ttl);
+
+    // returns true if successful, false if there are no sockets available
+    bool          start(const uint16_t port, const String &domainName, const IPAddress &resolvedIP);
+    void          stop(void);
+
+  private:
+    WiFiUDP       _udp;
+    uint16_t      _port;
+    String        _domainName;
+    unsigned char _resolvedIP[4];
+    uint32_t      _ttl;             // network byte order
+    DNSReplyCode  _errorReplyCode;
+
+    void          respondToRequest(uint8_t *buffer, size_t length);
+    void          replyWithIP(uint8_t *header, const uint8_t *query, size_t queryLength);
+    void          replyWithError(uint8_t *header, DNSReplyCode rcode, const uint8_t *query = NULL,
+                                 size_t queryLength = 0);
+    void          writeShort(uint16_t value);
+};
+
+#endif
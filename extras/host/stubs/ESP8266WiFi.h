@@ -0,0 +1,86 @@
+/**************************************************************
+   Host stand-in for the ESP8266 WiFi and ESP classes.
+   The radio is simulated in wchost.cpp: the AP comes up at once, scans
+   finish on the next poll with whatever the harness set, and a station
+   connect ends the way the harness said it would. See wchost.h.
+ **************************************************************/
+
+#ifndef WCHost_ESP8266WiFi_h
+#define WCHost_ESP8266WiFi_h
+
+#include <Arduino.h>
+#include <memory>
+
+enum WiFiMode_t { WIFI_OFF, WIFI_STA, WIFI_AP, WIFI_AP_STA };
+enum wl_status_t {
+    WL_IDLE_STATUS,
+    WL_NO_SSID_AVAIL,
+    WL_SCAN_COMPLETED,
+    WL_CONNECTED,
+    WL_CONNECT_FAILED,
+    WL_CONNECTION_LOST,
+    WL_WRONG_PASSWORD,
+    WL_DISCONNECTED,
+};
+enum { ENC_TYPE_WEP = 5, ENC_TYPE_TKIP = 2, ENC_TYPE_CCMP = 4, ENC_TYPE_NONE = 7, ENC_TYPE_AUTO = 8 };
+
+#define WIFI_SCAN_RUNNING   (-1)
+#define WIFI_SCAN_FAILED    (-2)
+
+struct WiFiEventSoftAPModeStationConnected { uint8_t mac[6]; uint8_t aid; };
+struct WiFiEventSoftAPModeStationDisconnected { uint8_t mac[6]; uint8_t aid; };
+
+// the callback lives as long as the handle does, same as the real thing
+struct WiFiEventHandlerOpaque {
+    std::function<void(uint8_t aid)> cb;
+};
+typedef std::shared_ptr<WiFiEventHandlerOpaque> WiFiEventHandler;
+
+class ESP8266WiFiClass {
+  public:
+    bool          mode(WiFiMode_t m);
+    WiFiMode_t    getMode(void);
+
+    bool          softAP(const char *ssid, const char *pass = NULL, int channel = 1, int hidden = 0, int maxConn = 4);
+    bool          softAPdisconnect(bool wifioff = false);
+    IPAddress     softAPIP(void);
+    uint8_t      *softAPmacAddress(uint8_t *mac);
+    uint8_t       softAPgetStationNum(void);
+
+    wl_status_t   begin(const char *ssid, const char *pass = NULL, int32_t channel = 0, const uint8_t *bssid = NULL, bool connect = true);
+    bool          config(IPAddress ip, IPAddress gateway, IPAddress subnet, IPAddress dns = IPAddress());
+    bool          disconnect(bool wifioff = false);
+    wl_status_t   status(void);
+    IPAddress     localIP(void);
+    IPAddress     gatewayIP(void);
+    IPAddress     subnetMask(void);
+    IPAddress     dnsIP(uint8_t n = 0);
+    uint8_t      *macAddress(uint8_t *mac);
+    uint8_t      *BSSID(void);
+    int32_t       channel(void);
+
+    int8_t        scanNetworks(bool async = false, bool showHidden = false);
+    int8_t        scanComplete(void);
+    void          scanDelete(void);
+    String        SSID(uint8_t i);
+    int32_t       RSSI(uint8_t i);
+    uint8_t       encryptionType(uint8_t i);
+
+    WiFiEventHandler onSoftAPModeStationConnected(std::function<void(const WiFiEventSoftAPModeStationConnected &)> cb);
+    WiFiEventHandler onSoftAPModeStationDisconnected(std::function<void(const WiFiEventSoftAPModeStationDisconnected &)> cb);
+};
+extern ESP8266WiFiClass WiFi;
+
+class EspClass {
+  public:
+    // restarting ends a real run, here it's only noted
+    void          restart(void);
+    uint32_t      getChipId(void);
+    uint32_t      getFreeHeap(void);
+    uint32_t      getMaxFreeBlockSize(void);
+    bool          rtcUserMemoryRead(uint32_t offset, uint32_t *data, size_t size);
+    bool          rtcUserMemoryWrite(uint32_t offset, uint32_t *data, size_t size);
+};
+extern EspClass ESP;
+
+#endif
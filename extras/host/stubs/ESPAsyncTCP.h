@@ -0,0 +1,66 @@
+/**************************************************************
+   Host stand-in for ESPAsyncTCP. There's no socket underneath: the
+   harness opens a connection by handing a new AsyncClient to whatever
+   AsyncServer is listening on the port (wchost::Connection does this),
+   and closing one runs its disconnect callback, which deletes it.
+ **************************************************************/
+
+#ifndef WCHost_ESPAsyncTCP_h
+#define WCHost_ESPAsyncTCP_h
+
+#include <Arduino.h>
+
+class AsyncClient;
+class AsyncWebServerRequest;
+class AsyncEventSourceClient;
+namespace wchost { class Connection; }
+
+typedef std::function<void(void *, AsyncClient *)> AcConnectHandler;
+
+class AsyncClient {
+  public:
+    AsyncClient(IPAddress ip, uint16_t port) : _ip(ip), _port(port) {}
+    ~AsyncClient();
+
+    IPAddress     remoteIP(void) { return _ip; }
+    uint16_t      remotePort(void) { return _port; }
+    void          setRxTimeout(uint32_t) {}
+    bool          connected(void) { return !_closed; }
+    // runs the disconnect callback, which is expected to delete the client
+    void          close(bool now = false);
+    int8_t        abort(void) { close(true); return 0; }
+    bool          free(void) { return true; }
+    void          onDisconnect(AcConnectHandler cb, void *arg = 0) { _onDisconnect = cb; _onDisconnectArg = arg; }
+
+    // host side: what's riding on the connection
+    AsyncWebServerRequest  *_request = NULL;
+    AsyncEventSourceClient *_events = NULL;
+    wchost::Connection     *_owner = NULL;
+
+  private:
+    IPAddress     _ip;
+    uint16_t      _port;
+    bool          _closed = false;
+    AcConnectHandler _onDisconnect;
+    void         *_onDisconnectArg = NULL;
+};
+
+class AsyncServer {
+  public:
+    AsyncServer(uint16_t port) : _port(port) {}
+    ~AsyncServer() { end(); }
+
+    void          onClient(AcConnectHandler cb, void *arg) { _onClient = cb; _onClientArg = arg; }
+    void          begin(void);
+    void          end(void);
+
+    // host side: a client connecting
+    void          _accept(AsyncClient *c) { if (_onClient) _onClient(_onClientArg, c); }
+
+  private:
+    uint16_t      _port;
+    AcConnectHandler _onClient;
+    void         *_onClientArg = NULL;
+};
+
+#endif
@@ -0,0 +1,249 @@
+/**************************************************************
+   Host stand-in for ESPAsyncWebServer, the parts WIFIConfig uses.
+   Requests reach the handlers the way the real server hands them over:
+   accepted off the AsyncServer, matched to the first handler that'll take
+   them, body first, then handleRequest(). Responses are pulled out a piece
+   at a time by the harness, and the connection closes once one's out.
+   wchost::Connection drives all of that.
+ **************************************************************/
+
+#ifndef WCHost_ESPAsyncWebServer_h
+#define WCHost_ESPAsyncWebServer_h
+
+#include <Arduino.h>
+#include <ESPAsyncTCP.h>
+#include <vector>
+
+typedef enum {
+    HTTP_GET        = 0b00000001,
+    HTTP_POST       = 0b00000010,
+    HTTP_DELETE     = 0b00000100,
+    HTTP_PUT        = 0b00001000,
+    HTTP_PATCH      = 0b00010000,
+    HTTP_HEAD       = 0b00100000,
+    HTTP_OPTIONS    = 0b01000000,
+    HTTP_ANY        = 0b01111111,
+} WebRequestMethod;
+typedef uint8_t WebRequestMethodComposite;
+
+#define RESPONSE_TRY_AGAIN  0xFFFFFFFF
+
+class AsyncWebServer;
+class AsyncWebServerRequest;
+class AsyncWebHandler;
+
+typedef std::function<size_t(uint8_t *, size_t, size_t)> AwsResponseFiller;
+typedef std::function<void(void)> ArDisconnectHandler;
+
+class AsyncWebHeader {
+  public:
+    AsyncWebHeader(const String &name, const String &value) : _name(name), _value(value) {}
+    const String &name(void) const { return _name; }
+    const String &value(void) const { return _value; }
+  private:
+    String        _name;
+    String        _value;
+};
+
+class AsyncWebParameter {
+  public:
+    AsyncWebParameter(const String &name, const String &value, bool post) : _name(name), _value(value), _post(post) {}
+    const String &name(void) const { return _name; }
+    const String &value(void) const { return _value; }
+    size_t        size(void) const { return _value.length(); }
+    bool          isPost(void) const { return _post; }
+    bool          isFile(void) const { return false; }
+  private:
+    String        _name;
+    String        _value;
+    bool          _post;
+};
+
+class AsyncWebServerResponse {
+  public:
+    AsyncWebServerResponse(int code, const String &contentType) : _code(code), _contentType(contentType) {}
+    virtual ~AsyncWebServerResponse() {}
+
+    void          setCode(int code) { _code = code; }
+    void          setContentLength(size_t len) { _contentLength = len; }
+    void          setContentType(const String &type) { _contentType = type; }
+    void          addHeader(const String &name, const String &value) { _headers.push_back(AsyncWebHeader(name, value)); }
+
+    // host side: up to 'maxLen' more bytes of the body, starting at 'index'.
+    // 0 once it's all out, RESPONSE_TRY_AGAIN if there's nothing yet
+    virtual size_t _fill(uint8_t * /*buf*/, size_t /*maxLen*/, size_t /*index*/) { return 0; }
+
+    int           _code;
+    bool          _chunked = false;       // ends when _fill() returns 0, rather than at _contentLength
+    String        _contentType;
+    size_t        _contentLength = 0;
+    std::vector<AsyncWebHeader> _headers;
+};
+
+// fixed content, from RAM or PROGMEM
+class AsyncBasicResponse : public AsyncWebServerResponse {
+  public:
+    AsyncBasicResponse(int code, const String &contentType, const String &content)
+        : AsyncWebServerResponse(code, contentType), _content(content) {
+        _contentLength = _content.length();
+    }
+    AsyncBasicResponse(int code, const String &contentType, const uint8_t *content, size_t len)
+        : AsyncWebServerResponse(code, contentType), _data(content) {
+        _contentLength = len;
+    }
+    size_t        _fill(uint8_t *buf, size_t maxLen, size_t index) override;
+  private:
+    String        _content;
+    const uint8_t *_data = NULL;
+};
+
+// content from a filler, of a known length or chunked
+class AsyncCallbackResponse : public AsyncWebServerResponse {
+  public:
+    AsyncCallbackResponse(const String &contentType, size_t len, AwsResponseFiller filler, bool chunked)
+        : AsyncWebServerResponse(200, contentType), _filler(filler) {
+        _contentLength = len;
+        _chunked = chunked;
+    }
+    size_t        _fill(uint8_t *buf, size_t maxLen, size_t index) override;
+  private:
+    AwsResponseFiller _filler;
+};
+
+class AsyncResponseStream : public AsyncWebServerResponse, public Print {
+  public:
+    AsyncResponseStream(const String &contentType, size_t bufferSize) : AsyncWebServerResponse(200, contentType) {
+        _content.reserve(bufferSize);
+    }
+    using Print::write;
+    size_t        write(uint8_t c) override { _content += (char)c; return 1; }
+    size_t        write(const uint8_t *buf, size_t len) override { _content.append((const char *)buf, len); return len; }
+    size_t        _fill(uint8_t *buf, size_t maxLen, size_t index) override;
+  private:
+    std::string   _content;
+};
+
+class AsyncWebServerRequest {
+  public:
+    AsyncWebServerRequest(AsyncWebServer *server, AsyncClient *client);
+    ~AsyncWebServerRequest();
+
+    void         *_tempObject = NULL;      // freed with free() along with the request
+
+    AsyncClient  *client(void) { return _client; }
+    WebRequestMethodComposite method(void) const { return _method; }
+    const String &url(void) const { return _url; }
+    const String &contentType(void) const { return _contentType; }
+    size_t        contentLength(void) const { return _contentLength; }
+
+    bool          hasHeader(const String &name) const { return getHeader(name) != NULL; }
+    AsyncWebHeader *getHeader(const String &name) const;
+    size_t        params(void) const { return _params.size(); }
+    AsyncWebParameter *getParam(size_t i) const;
+
+    void          send(AsyncWebServerResponse *response);
+    void          send(int code, const String &contentType = String(), const String &content = String());
+    void          redirect(const String &url);
+    AsyncWebServerResponse *beginResponse(int code, const String &contentType = String(), const String &content = String());
+    AsyncWebServerResponse *beginResponse(const String &contentType, size_t len, AwsResponseFiller filler);
+    AsyncWebServerResponse *beginChunkedResponse(const String &contentType, AwsResponseFiller filler);
+    AsyncResponseStream *beginResponseStream(const String &contentType, size_t bufferSize = 1460);
+    AsyncWebServerResponse *beginResponse_P(int code, const String &contentType, const uint8_t *content, size_t len);
+
+    void          onDisconnect(ArDisconnectHandler fn) { _onDisconnectfn = fn; }
+
+    // host side: what the real request gets out of parsing, and its end
+    WebRequestMethodComposite _method = HTTP_GET;
+    String        _url;
+    String        _contentType;
+    size_t        _contentLength = 0;
+    std::vector<AsyncWebHeader> _headers;
+    std::vector<AsyncWebParameter> _params;
+    AsyncWebHandler *_handler = NULL;
+    AsyncWebServerResponse *_response = NULL;
+    // the headers are in: find the handler, feed it the body, then have it answer
+    void          _received(const uint8_t *body, size_t len, size_t chunk);
+    void          _onDisconnect(void);
+
+  private:
+    AsyncWebServer *_server;
+    AsyncClient  *_client;
+    ArDisconnectHandler _onDisconnectfn;
+};
+
+class AsyncWebHandler {
+  public:
+    virtual ~AsyncWebHandler() {}
+    virtual bool  canHandle(AsyncWebServerRequest * /*request*/) { return false; }
+    virtual void  handleRequest(AsyncWebServerRequest * /*request*/) {}
+    virtual void  handleBody(AsyncWebServerRequest * /*request*/, uint8_t * /*data*/, size_t /*len*/, size_t /*index*/,
+                             size_t /*total*/) {}
+    virtual bool  isRequestHandlerTrivial(void) { return true; }
+};
+
+class AsyncEventSource;
+
+class AsyncEventSourceClient {
+  public:
+    // takes the request's connection over, and deletes the request without its disconnect callback
+    AsyncEventSourceClient(AsyncWebServerRequest *request, AsyncEventSource *server);
+    ~AsyncEventSourceClient();
+
+    AsyncClient  *client(void) { return _client; }
+    bool          connected(void) const { return _client != NULL && _client->connected(); }
+    void          close(void) { if (_client != NULL) _client->close(); }
+    void          send(const char *message, const char *event = NULL, uint32_t id = 0, uint32_t reconnect = 0);
+    void          _onDisconnect(void);
+
+  private:
+    AsyncClient  *_client;
+    AsyncEventSource *_server;
+};
+
+typedef std::function<void(AsyncEventSourceClient *client)> ArEventHandlerFunction;
+
+class AsyncEventSource : public AsyncWebHandler {
+  public:
+    AsyncEventSource(const String &url) : _url(url) {}
+    ~AsyncEventSource() { close(); }
+
+    void          onConnect(ArEventHandlerFunction cb) { _connectcb = cb; }
+    void          close(void);
+    void          send(const char *message, const char *event = NULL, uint32_t id = 0, uint32_t reconnect = 0);
+    size_t        count(void) const { return _clients.size(); }
+    // frames go out as soon as they're sent here
+    size_t        avgPacketsWaiting(void) const { return 0; }
+
+    bool          canHandle(AsyncWebServerRequest *request) override;
+    void          handleRequest(AsyncWebServerRequest *request) override;
+
+    void          _addClient(AsyncEventSourceClient *client);
+    void          _handleDisconnect(AsyncEventSourceClient *client);
+
+  private:
+    String        _url;
+    std::vector<AsyncEventSourceClient *> _clients;
+    ArEventHandlerFunction _connectcb;
+};
+
+class AsyncWebServer {
+  public:
+    AsyncWebServer(uint16_t port);
+    ~AsyncWebServer();
+
+    void          begin(void) { _server.begin(); }
+    void          end(void) { _server.end(); }
+    // owned by the server from here on
+    AsyncWebHandler &addHandler(AsyncWebHandler *handler) { _handlers.push_back(handler); return *handler; }
+    bool          removeHandler(AsyncWebHandler *handler);
+    void          reset(void);
+
+    void          _attachHandler(AsyncWebServerRequest *request);
+    void          _handleDisconnect(AsyncWebServerRequest *request) { delete request; }
+
+  protected:
+    AsyncServer   _server;
+    std::vector<AsyncWebHandler *> _handlers;
+};
+
+#endif
@@ -0,0 +1,50 @@
+/**************************************************************
+   Host stand-in for the Arduino core's FS. Files live in memory, in
+   wchost.cpp, where the harness can look at them, damage them, or cut
+   the power partway through a write. Writes land as they're made, the
+   way a filesystem without LittleFS's copy-on-write would take them,
+   so a write that's cut short leaves whatever got out in the file.
+ **************************************************************/
+
+#ifndef WCHost_FS_h
+#define WCHost_FS_h
+
+#include <Arduino.h>
+#include <memory>
+
+namespace wchost { struct OpenFile; }
+
+enum SeekMode {
+    SeekSet = 0,
+    SeekCur = 1,
+    SeekEnd = 2,
+};
+
+class File {
+  public:
+    size_t        write(const uint8_t *buf, size_t size);
+    size_t        read(uint8_t *buf, size_t size);
+    bool          seek(uint32_t pos, SeekMode mode = SeekSet);
+    size_t        position(void) const;
+    size_t        size(void) const;
+    void          close(void);
+    operator bool() const { return _open != nullptr; }
+
+  private:
+    friend class FS;
+    std::shared_ptr<wchost::OpenFile> _open;
+};
+
+class FS {
+  public:
+    bool          begin(bool formatOnFail = false);
+    void          end(void) {}
+    bool          format(void);
+    // "r", "w" or "a", with a '+' to both read and write
+    File          open(const char *path, const char *mode);
+    bool          exists(const char *path);
+    bool          remove(const char *path);
+    bool          rename(const char *from, const char *to);
+};
+
+#endif
@@ -0,0 +1,12 @@
+/**************************************************************
+   Host stand-in for LittleFS, the in-memory FS of stubs/FS.h.
+ **************************************************************/
+
+#ifndef WCHost_LittleFS_h
+#define WCHost_LittleFS_h
+
+#include <FS.h>
+
+extern FS LittleFS;
+
+#endif
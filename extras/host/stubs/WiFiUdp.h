@@ -0,0 +1,44 @@
+/**************************************************************
+   Host stand-in for WiFiUDP. Datagrams go through queues in wchost.cpp
+   rather than a socket: the harness posts queries to a port with
+   wchost::udpSend() and collects what was sent back with udpReceive().
+ **************************************************************/
+
+#ifndef WCHost_WiFiUdp_h
+#define WCHost_WiFiUdp_h
+
+#include <Arduino.h>
+#include <vector>
+
+class WiFiUDP {
+  public:
+    ~WiFiUDP() { stop(); }
+
+    uint8_t       begin(uint16_t port);
+    void          stop(void);
+
+    // takes the next datagram off the queue, returns its length or 0 if there's none
+    int           parsePacket(void);
+    int           read(unsigned char *buf, size_t len);
+    int           available(void) { return _packet.size() - _pos; }
+    void          flush(void) { _pos = _packet.size(); }
+    IPAddress     remoteIP(void) { return _remoteIP; }
+    uint16_t      remotePort(void) { return _remotePort; }
+
+    int           beginPacket(IPAddress ip, uint16_t port);
+    size_t        write(const uint8_t *buf, size_t len);
+    int           endPacket(void);
+
+  private:
+    uint16_t      _port = 0;
+    std::vector<uint8_t> _packet;
+    size_t        _pos = 0;
+    IPAddress     _remoteIP;
+    uint16_t      _remotePort = 0;
+
+    std::vector<uint8_t> _out;
+    IPAddress     _outIP;
+    uint16_t      _outPort = 0;
+};
+
+#endif
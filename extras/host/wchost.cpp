@@ -0,0 +1,1230 @@
+#include "wchost.h"
+#include <WiFiUdp.h>
+#include <DNSServer.h>
+#include <LittleFS.h>
+#include <arpa/inet.h>
+#include <malloc.h>
+#include <time.h>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <memory>
+
+/** Heap accounting. malloc and friends are wrapped for the whole process, operator new included */
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *p, size_t size);
+extern "C" void  __libc_free(void *p);
+
+namespace wchost {
+HeapStats heap;
+static bool heapTracking = false;
+static int heapPaused = 0;
+}
+
+/* blocks the harness allocated while paused, which 'live' leaves out. Open addressing, so it never allocates */
+#define HARNESS_BLOCKS  (1 << 16)
+static uintptr_t harnessBlocks[HARNESS_BLOCKS];
+static size_t harnessCount = 0;
+
+static size_t blockSlot(uintptr_t p) {
+    return (p >> 4) * 2654435761u % HARNESS_BLOCKS;
+}
+
+static void addHarnessBlock(void *p) {
+    if (harnessCount >= HARNESS_BLOCKS - 1) {
+        fprintf(stderr, "wchost: too many harness allocations live\n");
+        abort();
+    }
+    size_t i = blockSlot((uintptr_t)p);
+    while (harnessBlocks[i] != 0)
+        i = (i + 1) % HARNESS_BLOCKS;
+    harnessBlocks[i] = (uintptr_t)p;
+    harnessCount++;
+}
+
+static bool takeHarnessBlock(void *p) {
+    if (harnessCount == 0)
+        return false;
+    size_t i = blockSlot((uintptr_t)p);
+    while (harnessBlocks[i] != (uintptr_t)p) {
+        if (harnessBlocks[i] == 0)
+            return false;
+        i = (i + 1) % HARNESS_BLOCKS;
+    }
+    // shift back whatever follows in the run, so lookups never stop short
+    size_t hole = i;
+    for (size_t j = (i + 1) % HARNESS_BLOCKS; harnessBlocks[j] != 0; j = (j + 1) % HARNESS_BLOCKS) {
+        size_t home = blockSlot(harnessBlocks[j]);
+        if ((j > hole && (home <= hole || home > j)) || (j < hole && home <= hole && home > j)) {
+            harnessBlocks[hole] = harnessBlocks[j];
+            hole = j;
+        }
+    }
+    harnessBlocks[hole] = 0;
+    harnessCount--;
+    return true;
+}
+
+static void noteAlloc(void *p) {
+    if (p == NULL)
+        return;
+    if (wchost::heapPaused > 0) {
+        addHarnessBlock(p);
+        return;
+    }
+    size_t size = malloc_usable_size(p);
+    wchost::heap.live += size;
+    wchost::heap.blocks++;
+    if (wchost::heap.live > wchost::heap.peak)
+        wchost::heap.peak = wchost::heap.live;
+    if (wchost::heapTracking) {
+        wchost::heap.allocs++;
+        wchost::heap.allocBytes += size;
+    }
+}
+
+static void noteFree(void *p) {
+    if (p != NULL && !takeHarnessBlock(p)) {
+        wchost::heap.live -= malloc_usable_size(p);
+        wchost::heap.blocks--;
+    }
+}
+
+extern "C" void *malloc(size_t size) {
+    void *p = __libc_malloc(size);
+    noteAlloc(p);
+    return p;
+}
+
+extern "C" void *calloc(size_t n, size_t size) {
+    void *p = __libc_calloc(n, size);
+    noteAlloc(p);
+    return p;
+}
+
+extern "C" void *realloc(void *p, size_t size) {
+    if (p == NULL)
+        return malloc(size);
+    size_t old = malloc_usable_size(p);
+    void *q = __libc_realloc(p, size);
+    if (q == NULL && size != 0)
+        return NULL;
+    // counted as freeing the old block and allocating the new one
+    if (!takeHarnessBlock(p)) {
+        wchost::heap.live -= old;
+        wchost::heap.blocks--;
+    }
+    noteAlloc(q);
+    return q;
+}
+
+extern "C" void free(void *p) {
+    noteFree(p);
+    __libc_free(p);
+}
+
+namespace wchost {
+
+void trackHeap(bool on) {
+    heapTracking = on;
+}
+
+bool trackingHeap(void) {
+    return heapTracking;
+}
+
+void pauseHeap(bool on) {
+    heapPaused += on ? 1 : -1;
+}
+
+void resetPeak(void) {
+    heap.base = heap.live;
+    heap.peak = heap.live;
+}
+
+}
+
+/** Time */
+static unsigned long nowMs = 0;
+
+unsigned long millis(void) {
+    return nowMs;
+}
+
+unsigned long micros(void) {
+    return nowMs * 1000UL;
+}
+
+void delay(unsigned long ms) {
+    nowMs += ms;
+}
+
+void yield(void) {
+}
+
+namespace wchost {
+
+void advance(unsigned long ms) {
+    nowMs += ms;
+}
+
+uint64_t wallNanos(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+}
+
+HardwareSerial Serial;
+
+// stdio allocates its buffer on the first write, where the UART's is there from the start
+size_t HardwareSerial::write(uint8_t c) {
+    wchost::HeapPause pause;
+    return fputc(c, stdout) == EOF ? 0 : 1;
+}
+
+/** Radio */
+static WiFiMode_t wifiMode = WIFI_OFF;
+static bool apUp = false;
+static std::vector<wchost::Network> scanResults;
+static bool scanRunning = false;
+static int scanFound = WIFI_SCAN_FAILED;
+static wl_status_t connectResult = WL_CONNECTED;
+static unsigned long connectAfter = 0;
+static bool connecting = false;
+static unsigned long connectStart = 0;
+static wl_status_t stationStatus = WL_DISCONNECTED;
+// registered handlers, each taking itself off its list when the last reference to it goes
+static std::vector<WiFiEventHandlerOpaque *> joinedHandlers;
+static std::vector<WiFiEventHandlerOpaque *> leftHandlers;
+static bool restartCalled = false;
+static uint32_t rtcMemory[128];
+
+ESP8266WiFiClass WiFi;
+EspClass ESP;
+
+bool ESP8266WiFiClass::mode(WiFiMode_t m) {
+    wifiMode = m;
+    if (m == WIFI_STA || m == WIFI_OFF)
+        apUp = false;
+    return true;
+}
+
+WiFiMode_t ESP8266WiFiClass::getMode(void) {
+    return wifiMode;
+}
+
+bool ESP8266WiFiClass::softAP(const char *, const char *, int, int, int) {
+    if (wifiMode == WIFI_STA || wifiMode == WIFI_OFF)
+        wifiMode = wifiMode == WIFI_STA ? WIFI_AP_STA : WIFI_AP;
+    apUp = true;
+    return true;
+}
+
+bool ESP8266WiFiClass::softAPdisconnect(bool) {
+    apUp = false;
+    return true;
+}
+
+IPAddress ESP8266WiFiClass::softAPIP(void) {
+    return apUp ? IPAddress(192, 168, 4, 1) : IPAddress();
+}
+
+uint8_t *ESP8266WiFiClass::softAPmacAddress(uint8_t *mac) {
+    static const uint8_t ap[6] = { 0x5e, 0xcf, 0x7f, 0x00, 0x00, 0x01 };
+    memcpy(mac, ap, sizeof(ap));
+    return mac;
+}
+
+uint8_t ESP8266WiFiClass::softAPgetStationNum(void) {
+    return 0;
+}
+
+wl_status_t ESP8266WiFiClass::begin(const char *, const char *, int32_t, const uint8_t *, bool) {
+    connecting = true;
+    connectStart = millis();
+    stationStatus = WL_DISCONNECTED;
+    return stationStatus;
+}
+
+bool ESP8266WiFiClass::config(IPAddress, IPAddress, IPAddress, IPAddress) {
+    return true;
+}
+
+bool ESP8266WiFiClass::disconnect(bool) {
+    connecting = false;
+    stationStatus = WL_DISCONNECTED;
+    return true;
+}
+
+wl_status_t ESP8266WiFiClass::status(void) {
+    if (connecting && millis() - connectStart >= connectAfter) {
+        connecting = false;
+        stationStatus = connectResult;
+    }
+    return stationStatus;
+}
+
+IPAddress ESP8266WiFiClass::localIP(void) {
+    return stationStatus == WL_CONNECTED ? IPAddress(192, 168, 1, 50) : IPAddress();
+}
+
+IPAddress ESP8266WiFiClass::gatewayIP(void) {
+    return IPAddress(192, 168, 1, 1);
+}
+
+IPAddress ESP8266WiFiClass::subnetMask(void) {
+    return IPAddress(255, 255, 255, 0);
+}
+
+IPAddress ESP8266WiFiClass::dnsIP(uint8_t) {
+    return IPAddress(192, 168, 1, 1);
+}
+
+uint8_t *ESP8266WiFiClass::macAddress(uint8_t *mac) {
+    static const uint8_t sta[6] = { 0x5c, 0xcf, 0x7f, 0x00, 0x00, 0x01 };
+    memcpy(mac, sta, sizeof(sta));
+    return mac;
+}
+
+uint8_t *ESP8266WiFiClass::BSSID(void) {
+    static uint8_t bssid[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+    return bssid;
+}
+
+int32_t ESP8266WiFiClass::channel(void) {
+    return 6;
+}
+
+int8_t ESP8266WiFiClass::scanNetworks(bool async, bool) {
+    if (wifiMode != WIFI_STA && wifiMode != WIFI_AP_STA)
+        return WIFI_SCAN_FAILED;
+    scanRunning = true;
+    if (async)
+        return WIFI_SCAN_RUNNING;
+    return scanComplete();
+}
+
+// a scan's done by the time anyone asks
+int8_t ESP8266WiFiClass::scanComplete(void) {
+    if (scanRunning) {
+        scanRunning = false;
+        scanFound = scanResults.size();
+    }
+    return scanFound;
+}
+
+void ESP8266WiFiClass::scanDelete(void) {
+    scanRunning = false;
+    scanFound = WIFI_SCAN_FAILED;
+}
+
+String ESP8266WiFiClass::SSID(uint8_t i) {
+    return i < scanResults.size() ? String(scanResults[i].ssid) : String();
+}
+
+int32_t ESP8266WiFiClass::RSSI(uint8_t i) {
+    return i < scanResults.size() ? scanResults[i].rssi : 0;
+}
+
+uint8_t ESP8266WiFiClass::encryptionType(uint8_t i) {
+    return i < scanResults.size() && scanResults[i].secure ? ENC_TYPE_CCMP : ENC_TYPE_NONE;
+}
+
+static WiFiEventHandler addHandler(std::vector<WiFiEventHandlerOpaque *> &list, std::function<void(uint8_t)> cb) {
+    WiFiEventHandler handler(new WiFiEventHandlerOpaque, [&list](WiFiEventHandlerOpaque *h) {
+        {
+            wchost::HeapPause pause;
+            list.erase(std::find(list.begin(), list.end(), h));
+        }
+        delete h;
+    });
+    handler->cb = cb;
+    // the core's own bookkeeping
+    wchost::HeapPause pause;
+    list.push_back(handler.get());
+    return handler;
+}
+
+WiFiEventHandler ESP8266WiFiClass::onSoftAPModeStationConnected(std::function<void(const WiFiEventSoftAPModeStationConnected &)> cb) {
+    return addHandler(joinedHandlers, [cb](uint8_t aid) {
+        WiFiEventSoftAPModeStationConnected ev = { { 0 }, aid };
+        cb(ev);
+    });
+}
+
+WiFiEventHandler ESP8266WiFiClass::onSoftAPModeStationDisconnected(std::function<void(const WiFiEventSoftAPModeStationDisconnected &)> cb) {
+    return addHandler(leftHandlers, [cb](uint8_t aid) {
+        WiFiEventSoftAPModeStationDisconnected ev = { { 0 }, aid };
+        cb(ev);
+    });
+}
+
+void EspClass::restart(void) {
+    restartCalled = true;
+}
+
+uint32_t EspClass::getChipId(void) {
+    return 0x00C0FFEE;
+}
+
+uint32_t EspClass::getFreeHeap(void) {
+    int64_t used = wchost::heap.live - wchost::heap.base;
+    return used < WCHOST_HEAP_SIZE ? WCHOST_HEAP_SIZE - used : 0;
+}
+
+uint32_t EspClass::getMaxFreeBlockSize(void) {
+    return getFreeHeap();
+}
+
+bool EspClass::rtcUserMemoryRead(uint32_t offset, uint32_t *data, size_t size) {
+    if (offset * 4 + size > sizeof(rtcMemory))
+        return false;
+    memcpy(data, rtcMemory + offset, size);
+    return true;
+}
+
+bool EspClass::rtcUserMemoryWrite(uint32_t offset, uint32_t *data, size_t size) {
+    if (offset * 4 + size > sizeof(rtcMemory))
+        return false;
+    memcpy(rtcMemory + offset, data, size);
+    return true;
+}
+
+namespace wchost {
+
+void setScanResults(const Network *nets, size_t count) {
+    HeapPause pause;
+    scanResults.assign(nets, nets + count);
+}
+
+void setConnectResult(wl_status_t status, unsigned long afterMs) {
+    connectResult = status;
+    connectAfter = afterMs;
+}
+
+static void fire(std::vector<WiFiEventHandlerOpaque *> &list, uint8_t aid) {
+    std::vector<WiFiEventHandlerOpaque *> handlers;
+    {
+        wchost::HeapPause pause;
+        handlers = list;
+    }
+    for (size_t i = 0; i < handlers.size(); i++)
+        handlers[i]->cb(aid);
+    wchost::HeapPause pause;
+    handlers.clear();
+    handlers.shrink_to_fit();
+}
+
+void stationJoined(uint8_t aid) {
+    fire(joinedHandlers, aid);
+}
+
+void stationLeft(uint8_t aid) {
+    fire(leftHandlers, aid);
+}
+
+bool restarted(void) {
+    return restartCalled;
+}
+
+}
+
+/** UDP */
+static std::map<uint16_t, std::deque<wchost::Datagram>> udpInbound;
+
+// made on first use rather than at startup, a deque allocates as it's constructed and that has to be paused too
+static std::deque<wchost::Datagram> &udpOutbound(void) {
+    static std::deque<wchost::Datagram> *queue = NULL;
+    if (queue == NULL) {
+        wchost::HeapPause pause;
+        queue = new std::deque<wchost::Datagram>();
+    }
+    return *queue;
+}
+
+uint8_t WiFiUDP::begin(uint16_t port) {
+    stop();
+    wchost::HeapPause pause;
+    _port = port;
+    udpInbound[port];
+    return 1;
+}
+
+void WiFiUDP::stop(void) {
+    if (_port == 0)
+        return;
+    wchost::HeapPause pause;
+    udpInbound.erase(_port);
+    _port = 0;
+}
+
+int WiFiUDP::parsePacket(void) {
+    auto queue = udpInbound.find(_port);
+    if (_port == 0 || queue == udpInbound.end() || queue->second.empty())
+        return 0;
+    wchost::Datagram &d = queue->second.front();
+    _packet.swap(d.data);
+    _pos = 0;
+    _remoteIP = d.ip;
+    _remotePort = d.port;
+    {
+        wchost::HeapPause pause;
+        queue->second.pop_front();
+    }
+    return _packet.size();
+}
+
+int WiFiUDP::read(unsigned char *buf, size_t len) {
+    size_t n = _packet.size() - _pos;
+    if (n > len)
+        n = len;
+    memcpy(buf, _packet.data() + _pos, n);
+    _pos += n;
+    return n;
+}
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port) {
+    _out.clear();
+    _outIP = ip;
+    _outPort = port;
+    return 1;
+}
+
+size_t WiFiUDP::write(const uint8_t *buf, size_t len) {
+    wchost::HeapPause pause;
+    _out.insert(_out.end(), buf, buf + len);
+    return len;
+}
+
+int WiFiUDP::endPacket(void) {
+    wchost::HeapPause pause;
+    wchost::Datagram d;
+    d.ip = _outIP;
+    d.port = _outPort;
+    d.data = _out;
+    udpOutbound().push_back(std::move(d));
+    return 1;
+}
+
+namespace wchost {
+
+bool udpSend(uint16_t port, const Datagram &d) {
+    HeapPause pause;
+    auto queue = udpInbound.find(port);
+    if (queue == udpInbound.end())
+        return false;
+    queue->second.push_back(d);
+    return true;
+}
+
+bool udpReceive(Datagram *d) {
+    HeapPause pause;
+    if (udpOutbound().empty())
+        return false;
+    *d = std::move(udpOutbound().front());
+    udpOutbound().pop_front();
+    return true;
+}
+
+std::vector<uint8_t> dnsQuery(uint16_t id, const char *name, uint16_t qtype) {
+    HeapPause pause;
+    std::vector<uint8_t> q = { (uint8_t)(id >> 8), (uint8_t)id, 0x01, 0x00, 0x00, 0x01, 0, 0, 0, 0, 0, 0 };
+    while (*name != 0) {
+        const char *dot = strchr(name, '.');
+        size_t len = dot != NULL ? (size_t)(dot - name) : strlen(name);
+        q.push_back(len);
+        q.insert(q.end(), name, name + len);
+        name += len;
+        if (*name == '.')
+            name++;
+    }
+    q.push_back(0);
+    q.push_back(qtype >> 8);
+    q.push_back(qtype);
+    q.push_back(0x00);
+    q.push_back(0x01);
+    return q;
+}
+
+}
+
+/** DNSServer, the ESP8266 core's, for comparison */
+DNSServer::DNSServer() : _port(0), _ttl(htonl(60)), _errorReplyCode(DNSReplyCode::NonExistentDomain) {
+    memset(_resolvedIP, 0, sizeof(_resolvedIP));
+}
+
+void DNSServer::setTTL(const uint32_t ttl) {
+    _ttl = htonl(ttl);
+}
+
+bool DNSServer::start(const uint16_t port, const String &domainName, const IPAddress &resolvedIP) {
+    _port = port;
+    _domainName = domainName;
+    for (int i = 0; i < 4; i++)
+        _resolvedIP[i] = resolvedIP[i];
+    return _udp.begin(_port) == 1;
+}
+
+void DNSServer::stop(void) {
+    _udp.stop();
+}
+
+void DNSServer::processNextRequest(void) {
+    size_t size = _udp.parsePacket();
+    if (size == 0 || size > MAX_DNS_PACKETSIZE || size < DNS_HEADER_SIZE)
+        return;
+
+    std::unique_ptr<uint8_t[]> buffer(new (std::nothrow) uint8_t[size]);
+    if (buffer == nullptr)
+        return;
+    _udp.read(buffer.get(), size);
+    respondToRequest(buffer.get(), size);
+}
+
+void DNSServer::respondToRequest(uint8_t *buffer, size_t length) {
+    // QR set, it's a response
+    if (buffer[2] & 0x80)
+        return;
+    // anything but a standard query
+    if (buffer[2] & 0x78)
+        return replyWithError(buffer, DNSReplyCode::NotImplemented);
+    // exactly one question, and nothing else
+    if (buffer[4] != 0 || buffer[5] != 1 || buffer[6] != 0 || buffer[7] != 0 || buffer[8] != 0 || buffer[9] != 0
+        || buffer[10] != 0 || buffer[11] != 0)
+        return replyWithError(buffer, DNSReplyCode::FormError);
+
+    const uint8_t *query = buffer + DNS_HEADER_SIZE, *p = query;
+    size_t remaining = length - DNS_HEADER_SIZE;
+    while (remaining != 0 && *p != 0) {
+        size_t label = *p;
+        if (label + 1 > remaining)
+            return replyWithError(buffer, DNSReplyCode::FormError);
+        remaining -= label + 1;
+        p += label + 1;
+    }
+    // the root label, type and class
+    if (remaining < 5)
+        return replyWithError(buffer, DNSReplyCode::FormError);
+    uint16_t qtype = p[1] << 8 | p[2], qclass = p[3] << 8 | p[4];
+    size_t queryLength = p + 5 - query;
+
+    // IN or ANY, A or ANY
+    if ((qclass != 1 && qclass != 255) || (qtype != 1 && qtype != 255))
+        return replyWithError(buffer, DNSReplyCode::NonExistentDomain, query, queryLength);
+    if (_domainName.length() == 0)
+        return replyWithError(buffer, _errorReplyCode, query, queryLength);
+    if (_domainName == "*")
+        return replyWithIP(buffer, query, queryLength);
+
+    // the name, label by label against the dotted domain
+    const char *match = _domainName.c_str();
+    for (p = query; *p != 0; p += *p + 1) {
+        if (p != query) {
+            if (*match++ != '.')
+                return replyWithError(buffer, _errorReplyCode, query, queryLength);
+        }
+        if (strncasecmp(match, (const char *)p + 1, *p) != 0)
+            return replyWithError(buffer, _errorReplyCode, query, queryLength);
+        match += *p;
+    }
+    if (*match != 0)
+        return replyWithError(buffer, _errorReplyCode, query, queryLength);
+    replyWithIP(buffer, query, queryLength);
+}
+
+void DNSServer::writeShort(uint16_t value) {
+    uint8_t b[2] = { (uint8_t)(value >> 8), (uint8_t)value };
+    _udp.write(b, 2);
+}
+
+void DNSServer::replyWithIP(uint8_t *header, const uint8_t *query, size_t queryLength) {
+    header[2] |= 0x80;
+    header[7] = 1;
+    _udp.beginPacket(_udp.remoteIP(), _udp.remotePort());
+    _udp.write(header, DNS_HEADER_SIZE);
+    _udp.write(query, queryLength);
+    // the name as a pointer back to the question, an A record in IN
+    writeShort(0xC000 | DNS_HEADER_SIZE);
+    writeShort(1);
+    writeShort(1);
+    _udp.write((const uint8_t *)&_ttl, 4);
+    writeShort(sizeof(_resolvedIP));
+    _udp.write(_resolvedIP, sizeof(_resolvedIP));
+    _udp.endPacket();
+}
+
+void DNSServer::replyWithError(uint8_t *header, DNSReplyCode rcode, const uint8_t *query, size_t queryLength) {
+    header[2] |= 0x80;
+    header[3] = (header[3] & 0xF0) | (uint8_t)rcode;
+    header[4] = 0;
+    header[5] = query != NULL ? 1 : 0;
+    memset(header + 6, 0, 6);
+    _udp.beginPacket(_udp.remoteIP(), _udp.remotePort());
+    _udp.write(header, DNS_HEADER_SIZE);
+    if (query != NULL)
+        _udp.write(query, queryLength);
+    _udp.endPacket();
+}
+
+/** Filesystem */
+namespace wchost {
+
+struct OpenFile {
+    std::shared_ptr<std::vector<uint8_t>> data;
+    size_t        pos = 0;
+    bool          read = false;
+    bool          write = false;
+};
+
+}
+
+FS LittleFS;
+
+static std::map<std::string, std::shared_ptr<std::vector<uint8_t>>> fsFiles;
+static bool fsPowerCut = false;
+static size_t fsPowerLeft = 0;
+
+size_t File::write(const uint8_t *buf, size_t size) {
+    if (!_open || !_open->write)
+        return 0;
+    if (fsPowerCut) {
+        size = size < fsPowerLeft ? size : fsPowerLeft;
+        fsPowerLeft -= size;
+    }
+    wchost::HeapPause pause;
+    std::vector<uint8_t> &d = *_open->data;
+    if (d.size() < _open->pos + size)
+        d.resize(_open->pos + size);
+    memcpy(d.data() + _open->pos, buf, size);
+    _open->pos += size;
+    return size;
+}
+
+size_t File::read(uint8_t *buf, size_t size) {
+    if (!_open || !_open->read)
+        return 0;
+    const std::vector<uint8_t> &d = *_open->data;
+    size_t n = _open->pos < d.size() ? d.size() - _open->pos : 0;
+    if (n > size)
+        n = size;
+    memcpy(buf, d.data() + _open->pos, n);
+    _open->pos += n;
+    return n;
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+    if (!_open)
+        return false;
+    size_t base = mode == SeekSet ? 0 : (mode == SeekCur ? _open->pos : _open->data->size());
+    if (base + pos > _open->data->size())
+        return false;
+    _open->pos = base + pos;
+    return true;
+}
+
+size_t File::position(void) const {
+    return _open ? _open->pos : 0;
+}
+
+size_t File::size(void) const {
+    return _open ? _open->data->size() : 0;
+}
+
+void File::close(void) {
+    wchost::HeapPause pause;
+    _open.reset();
+}
+
+bool FS::begin(bool /*formatOnFail*/) {
+    return true;
+}
+
+bool FS::format(void) {
+    wchost::fsFormat();
+    return true;
+}
+
+File FS::open(const char *path, const char *mode) {
+    wchost::HeapPause pause;
+    File f;
+    auto it = fsFiles.find(path);
+    if (mode[0] == 'r' && it == fsFiles.end())
+        return f;
+    if (it == fsFiles.end())
+        it = fsFiles.emplace(path, std::make_shared<std::vector<uint8_t>>()).first;
+    // truncated as it's opened, power or not
+    if (mode[0] == 'w')
+        it->second->clear();
+
+    f._open = std::make_shared<wchost::OpenFile>();
+    f._open->data = it->second;
+    f._open->read = mode[0] == 'r' || mode[1] == '+';
+    f._open->write = mode[0] != 'r' || mode[1] == '+';
+    f._open->pos = mode[0] == 'a' ? it->second->size() : 0;
+    return f;
+}
+
+bool FS::exists(const char *path) {
+    wchost::HeapPause pause;
+    return fsFiles.count(path) != 0;
+}
+
+bool FS::remove(const char *path) {
+    wchost::HeapPause pause;
+    return fsFiles.erase(path) != 0;
+}
+
+bool FS::rename(const char *from, const char *to) {
+    wchost::HeapPause pause;
+    auto it = fsFiles.find(from);
+    if (it == fsFiles.end())
+        return false;
+    fsFiles[to] = it->second;
+    fsFiles.erase(from);
+    return true;
+}
+
+namespace wchost {
+
+void fsFormat(void) {
+    HeapPause pause;
+    fsFiles.clear();
+}
+
+std::vector<uint8_t> *fsFile(const char *path) {
+    HeapPause pause;
+    auto it = fsFiles.find(path);
+    return it != fsFiles.end() ? it->second.get() : NULL;
+}
+
+void fsCutPowerAfter(size_t bytes) {
+    fsPowerCut = true;
+    fsPowerLeft = bytes;
+}
+
+void fsPowerOn(void) {
+    fsPowerCut = false;
+}
+
+}
+
+/** TCP */
+static std::map<uint16_t, AsyncServer *> listeners;
+
+AsyncClient::~AsyncClient() {
+    if (_owner != NULL)
+        _owner->_detach();
+}
+
+void AsyncClient::close(bool) {
+    if (_closed)
+        return;
+    _closed = true;
+    if (_onDisconnect)
+        _onDisconnect(_onDisconnectArg, this);
+    else
+        delete this;
+}
+
+void AsyncServer::begin(void) {
+    wchost::HeapPause pause;
+    listeners[_port] = this;
+}
+
+void AsyncServer::end(void) {
+    wchost::HeapPause pause;
+    auto it = listeners.find(_port);
+    if (it != listeners.end() && it->second == this)
+        listeners.erase(it);
+}
+
+/** Web server */
+size_t AsyncBasicResponse::_fill(uint8_t *buf, size_t maxLen, size_t index) {
+    if (index >= _contentLength)
+        return 0;
+    size_t n = _contentLength - index;
+    if (n > maxLen)
+        n = maxLen;
+    memcpy(buf, (_data != NULL ? _data : (const uint8_t *)_content.c_str()) + index, n);
+    return n;
+}
+
+size_t AsyncCallbackResponse::_fill(uint8_t *buf, size_t maxLen, size_t index) {
+    if (!_chunked) {
+        if (index >= _contentLength)
+            return 0;
+        if (maxLen > _contentLength - index)
+            maxLen = _contentLength - index;
+    }
+    return _filler(buf, maxLen, index);
+}
+
+size_t AsyncResponseStream::_fill(uint8_t *buf, size_t maxLen, size_t index) {
+    if (index >= _content.size())
+        return 0;
+    size_t n = _content.size() - index;
+    if (n > maxLen)
+        n = maxLen;
+    memcpy(buf, _content.data() + index, n);
+    return n;
+}
+
+AsyncWebServerRequest::AsyncWebServerRequest(AsyncWebServer *server, AsyncClient *client) : _server(server), _client(client) {
+    _client->_request = this;
+    _client->onDisconnect([](void *r, AsyncClient *c) {
+        ((AsyncWebServerRequest *)r)->_onDisconnect();
+        delete c;
+    }, this);
+}
+
+AsyncWebServerRequest::~AsyncWebServerRequest() {
+    delete _response;
+    if (_tempObject != NULL)
+        free(_tempObject);
+    if (_client->_request == this)
+        _client->_request = NULL;
+}
+
+AsyncWebHeader *AsyncWebServerRequest::getHeader(const String &name) const {
+    for (size_t i = 0; i < _headers.size(); i++) {
+        if (_headers[i].name().equalsIgnoreCase(name))
+            return const_cast<AsyncWebHeader *>(&_headers[i]);
+    }
+    return NULL;
+}
+
+AsyncWebParameter *AsyncWebServerRequest::getParam(size_t i) const {
+    return i < _params.size() ? const_cast<AsyncWebParameter *>(&_params[i]) : NULL;
+}
+
+void AsyncWebServerRequest::send(AsyncWebServerResponse *response) {
+    delete _response;
+    _response = response;
+}
+
+void AsyncWebServerRequest::send(int code, const String &contentType, const String &content) {
+    send(beginResponse(code, contentType, content));
+}
+
+void AsyncWebServerRequest::redirect(const String &url) {
+    AsyncWebServerResponse *response = beginResponse(302);
+    response->addHeader("Location", url);
+    send(response);
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginResponse(int code, const String &contentType, const String &content) {
+    return new AsyncBasicResponse(code, contentType, content);
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginResponse(const String &contentType, size_t len, AwsResponseFiller filler) {
+    return new AsyncCallbackResponse(contentType, len, filler, false);
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginChunkedResponse(const String &contentType, AwsResponseFiller filler) {
+    return new AsyncCallbackResponse(contentType, 0, filler, true);
+}
+
+AsyncResponseStream *AsyncWebServerRequest::beginResponseStream(const String &contentType, size_t bufferSize) {
+    return new AsyncResponseStream(contentType, bufferSize);
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginResponse_P(int code, const String &contentType, const uint8_t *content, size_t len) {
+    return new AsyncBasicResponse(code, contentType, content, len);
+}
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+static String urlDecode(const char *s, size_t len) {
+    std::string out;
+    for (size_t i = 0; i < len; i++) {
+        if (s[i] == '+') {
+            out += ' ';
+        } else if (s[i] == '%' && i + 2 < len && hexValue(s[i + 1]) >= 0 && hexValue(s[i + 2]) >= 0) {
+            out += (char)(hexValue(s[i + 1]) << 4 | hexValue(s[i + 2]));
+            i += 2;
+        } else {
+            out += s[i];
+        }
+    }
+    return String(out);
+}
+
+// name=value&... into parameters, as the real server does for query strings and plain form posts
+static void parseParams(std::vector<AsyncWebParameter> &params, const char *s, size_t len, bool post) {
+    size_t start = 0;
+    while (start < len) {
+        size_t end = start;
+        while (end < len && s[end] != '&')
+            end++;
+        size_t eq = start;
+        while (eq < end && s[eq] != '=')
+            eq++;
+        if (eq > start) {
+            params.push_back(AsyncWebParameter(urlDecode(s + start, eq - start),
+                                               eq < end ? urlDecode(s + eq + 1, end - eq - 1) : String(), post));
+        }
+        start = end + 1;
+    }
+}
+
+void AsyncWebServerRequest::_received(const uint8_t *body, size_t len, size_t chunk) {
+    _server->_attachHandler(this);
+    if (len > 0 && _contentType.startsWith("application/x-www-form-urlencoded")) {
+        if (_handler != NULL && !_handler->isRequestHandlerTrivial())
+            parseParams(_params, (const char *)body, len, true);
+    }
+    else if (len > 0 && _handler != NULL) {
+        for (size_t i = 0; i < len; i += chunk)
+            _handler->handleBody(this, (uint8_t *)body + i, len - i < chunk ? len - i : chunk, i, len);
+    }
+
+    if (_handler != NULL)
+        _handler->handleRequest(this);
+    else
+        send(501);
+}
+
+void AsyncWebServerRequest::_onDisconnect(void) {
+    if (_onDisconnectfn)
+        _onDisconnectfn();
+    _server->_handleDisconnect(this);
+}
+
+AsyncWebServer::AsyncWebServer(uint16_t port) : _server(port) {
+    _server.onClient([](void *s, AsyncClient *c) {
+        if (c == NULL)
+            return;
+        c->setRxTimeout(3);
+        new AsyncWebServerRequest((AsyncWebServer *)s, c);
+    }, this);
+}
+
+AsyncWebServer::~AsyncWebServer() {
+    end();
+    reset();
+}
+
+bool AsyncWebServer::removeHandler(AsyncWebHandler *handler) {
+    for (size_t i = 0; i < _handlers.size(); i++) {
+        if (_handlers[i] == handler) {
+            _handlers.erase(_handlers.begin() + i);
+            delete handler;
+            return true;
+        }
+    }
+    return false;
+}
+
+void AsyncWebServer::reset(void) {
+    for (size_t i = 0; i < _handlers.size(); i++)
+        delete _handlers[i];
+    _handlers.clear();
+}
+
+void AsyncWebServer::_attachHandler(AsyncWebServerRequest *request) {
+    for (size_t i = 0; i < _handlers.size(); i++) {
+        if (_handlers[i]->canHandle(request)) {
+            request->_handler = _handlers[i];
+            return;
+        }
+    }
+}
+
+/** Server-sent events */
+
+// the stream's headers. Once they're acked the request becomes a client, as in the real server
+class AsyncEventSourceResponse : public AsyncWebServerResponse {
+  public:
+    AsyncEventSourceResponse(AsyncEventSource *server, AsyncWebServerRequest *request)
+        : AsyncWebServerResponse(200, "text/event-stream"), _server(server), _request(request) {
+        _chunked = true;
+    }
+    // deletes the request and this along with it
+    size_t        _fill(uint8_t *, size_t, size_t) override {
+        new AsyncEventSourceClient(_request, _server);
+        return 0;
+    }
+  private:
+    AsyncEventSource *_server;
+    AsyncWebServerRequest *_request;
+};
+
+AsyncEventSourceClient::AsyncEventSourceClient(AsyncWebServerRequest *request, AsyncEventSource *server)
+    : _client(request->client()), _server(server) {
+    _client->_events = this;
+    _client->onDisconnect([](void *r, AsyncClient *c) {
+        ((AsyncEventSourceClient *)r)->_onDisconnect();
+        delete c;
+    }, this);
+    _server->_addClient(this);
+    delete request;
+}
+
+AsyncEventSourceClient::~AsyncEventSourceClient() {
+    if (_client != NULL && _client->_events == this)
+        _client->_events = NULL;
+}
+
+void AsyncEventSourceClient::send(const char *message, const char *event, uint32_t, uint32_t) {
+    if (!connected() || _client->_owner == NULL)
+        return;
+    wchost::HeapPause pause;
+    _client->_owner->events++;
+    _client->_owner->lastEvent = event != NULL ? event : "";
+    _client->_owner->lastData = message;
+}
+
+void AsyncEventSourceClient::_onDisconnect(void) {
+    _server->_handleDisconnect(this);
+}
+
+bool AsyncEventSource::canHandle(AsyncWebServerRequest *request) {
+    return request->method() == HTTP_GET && request->url() == _url;
+}
+
+void AsyncEventSource::handleRequest(AsyncWebServerRequest *request) {
+    request->send(new AsyncEventSourceResponse(this, request));
+}
+
+void AsyncEventSource::close(void) {
+    std::vector<AsyncEventSourceClient *> clients(_clients);
+    for (size_t i = 0; i < clients.size(); i++)
+        clients[i]->close();
+}
+
+void AsyncEventSource::send(const char *message, const char *event, uint32_t id, uint32_t reconnect) {
+    for (size_t i = 0; i < _clients.size(); i++)
+        _clients[i]->send(message, event, id, reconnect);
+}
+
+void AsyncEventSource::_addClient(AsyncEventSourceClient *client) {
+    _clients.push_back(client);
+    if (_connectcb)
+        _connectcb(client);
+}
+
+void AsyncEventSource::_handleDisconnect(AsyncEventSourceClient *client) {
+    for (size_t i = 0; i < _clients.size(); i++) {
+        if (_clients[i] == client) {
+            _clients.erase(_clients.begin() + i);
+            break;
+        }
+    }
+    delete client;
+}
+
+/** Client side */
+namespace wchost {
+
+static uint16_t nextPort = 49152;
+
+bool Connection::open(IPAddress from, uint16_t port) {
+    close();
+    code = 0;
+    body.clear();
+    location.clear();
+    events = 0;
+    _sent = 0;
+    _started = false;
+
+    auto it = listeners.find(port);
+    if (it == listeners.end())
+        return false;
+    _client = new AsyncClient(from, nextPort++);
+    _client->_owner = this;
+    it->second->_accept(_client);
+    // the server couldn't take it
+    if (_client != NULL && _client->_request == NULL)
+        close();
+    return _client != NULL;
+}
+
+void Connection::request(WebRequestMethod method, const char *url, const char *contentType, const char *body,
+                         size_t chunk, const char *headerName, const char *headerValue) {
+    if (_client == NULL || _client->_request == NULL)
+        return;
+    AsyncWebServerRequest *r = _client->_request;
+    r->_method = method;
+    const char *query = strchr(url, '?');
+    if (query != NULL) {
+        r->_url = String(std::string(url, query - url));
+        parseParams(r->_params, query + 1, strlen(query + 1), false);
+    } else {
+        r->_url = url;
+    }
+    if (contentType != NULL)
+        r->_contentType = contentType;
+    if (headerName != NULL)
+        r->_headers.push_back(AsyncWebHeader(headerName, headerValue));
+    size_t len = body != NULL ? strlen(body) : 0;
+    r->_contentLength = len;
+    r->_received((const uint8_t *)body, len, chunk > 0 ? chunk : len);
+}
+
+bool Connection::pump(size_t maxLen) {
+    if (_client == NULL)
+        return false;
+    if (_client->_events != NULL)
+        return true;
+    AsyncWebServerRequest *r = _client->_request;
+    if (r == NULL || r->_response == NULL)
+        return true;
+
+    AsyncWebServerResponse *response = r->_response;
+    if (!_started) {
+        _started = true;
+        HeapPause pause;
+        code = response->_code;
+        for (size_t i = 0; i < response->_headers.size(); i++) {
+            if (response->_headers[i].name().equalsIgnoreCase("Location"))
+                location = response->_headers[i].value().c_str();
+        }
+    }
+
+    uint8_t buf[1460];
+    if (maxLen > sizeof(buf))
+        maxLen = sizeof(buf);
+    size_t n = response->_fill(buf, maxLen, _sent);
+    // an /events request, it's a stream from here on
+    if (_client == NULL || _client->_events != NULL)
+        return _client != NULL;
+    if (n == RESPONSE_TRY_AGAIN)
+        return true;
+    if (n > 0) {
+        _sent += n;
+        if (keepBody) {
+            HeapPause pause;
+            body.append((const char *)buf, n);
+        }
+    }
+
+    bool done = response->_chunked ? n == 0 : _sent >= response->_contentLength;
+    if (!done)
+        return true;
+    // all out, the server closes the connection
+    _client->close(true);
+    return false;
+}
+
+void Connection::close(void) {
+    if (_client != NULL)
+        _client->close();
+    _client = NULL;
+}
+
+bool Connection::isEventStream(void) const {
+    return _client != NULL && _client->_events != NULL;
+}
+
+}
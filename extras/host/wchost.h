@@ -0,0 +1,135 @@
+/**************************************************************
+   Host harness for WIFIConfig: the controls behind the stand-ins in
+   stubs/, for the benchmarks and the soak test to drive the library with.
+   - a simulated clock, moved with advance() or by the library's delay()
+   - heap accounting, with malloc and friends counted while tracking is on
+   - a simulated radio: scan results, station joins, connect outcomes
+   - UDP queues, for DNS queries in and answers out
+   - an in-memory filesystem behind LittleFS, with power cuts
+   - Connection, one HTTP client talking to the portal's web server
+ **************************************************************/
+
+#ifndef WCHost_h
+#define WCHost_h
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <ESPAsyncWebServer.h>
+#include <string>
+#include <vector>
+
+namespace wchost {
+
+/* time */
+void          advance(unsigned long ms);
+// real time, for timing the library's own work
+uint64_t      wallNanos(void);
+
+/* heap: everything the library and the stand-ins allocate is counted, bar what's allocated under a HeapPause */
+struct HeapStats {
+    uint64_t      allocs;         // while tracking
+    uint64_t      allocBytes;     // while tracking
+    int64_t       live;           // bytes currently allocated, since the start
+    int64_t       blocks;         // blocks currently allocated, the same way
+    int64_t       base;           // 'live' at the last resetPeak()
+    int64_t       peak;           // highest 'live' since then
+};
+extern HeapStats heap;
+void          trackHeap(bool on);
+bool          trackingHeap(void);
+// nests. Blocks allocated while paused stay out of 'live' until they're freed, whenever that is
+void          pauseHeap(bool on);
+// start measuring the peak from here, which is also where the simulated device's heap starts out empty
+void          resetPeak(void);
+// what the simulated device has, ESP.getFreeHeap() is this less what's been allocated since resetPeak()
+#define WCHOST_HEAP_SIZE    (48 * 1024)
+
+// harness work that shouldn't count against the library, for as long as it's in scope
+class HeapPause {
+  public:
+    HeapPause() { pauseHeap(true); }
+    ~HeapPause() { pauseHeap(false); }
+};
+
+/* radio */
+struct Network {
+    const char   *ssid;
+    int           rssi;
+    bool          secure;
+};
+// what the next scans find
+void          setScanResults(const Network *nets, size_t count);
+// how the next station connect ends, and how long after WiFi.begin()
+void          setConnectResult(wl_status_t status, unsigned long afterMs);
+void          stationJoined(uint8_t aid);
+void          stationLeft(uint8_t aid);
+bool          restarted(void);
+
+/* UDP */
+struct Datagram {
+    IPAddress     ip;             // where it's from, or going to
+    uint16_t      port;
+    std::vector<uint8_t> data;
+};
+// queue a datagram for whoever's bound to 'port'. False if nobody is
+bool          udpSend(uint16_t port, const Datagram &d);
+// take the next datagram the library sent, false if there's none
+bool          udpReceive(Datagram *d);
+// a standard query for 'name', recursion desired, as a phone would send it
+std::vector<uint8_t> dnsQuery(uint16_t id, const char *name, uint16_t qtype = 1);
+
+/* filesystem */
+// empty it, as if freshly formatted
+void          fsFormat(void);
+// a file's contents, to look at or damage. NULL if there's no such file
+std::vector<uint8_t> *fsFile(const char *path);
+// the power goes after 'bytes' more are written: the write that crosses it is cut short, and nothing lands
+// after it until fsPowerOn()
+void          fsCutPowerAfter(size_t bytes);
+void          fsPowerOn(void);
+
+/* HTTP */
+class Connection {
+  public:
+    ~Connection() { close(); }
+
+    // connect to whoever's listening on 'port', false if nobody is
+    bool          open(IPAddress from, uint16_t port = 80);
+    // send a request over the connection. A body goes to the server in 'chunk'-byte pieces,
+    // as it would arrive off the network
+    void          request(WebRequestMethod method, const char *url, const char *contentType = NULL,
+                          const char *body = NULL, size_t chunk = 536,
+                          const char *headerName = NULL, const char *headerValue = NULL);
+    // let up to 'maxLen' more bytes of the response out, the way the real server does on each ack.
+    // The server closes the connection once it's all out. True until then
+    bool          pump(size_t maxLen = 1460);
+    // the client hanging up
+    void          close(void);
+
+    bool          isOpen(void) const { return _client != NULL; }
+    // bytes of the response body out so far
+    size_t        received(void) const { return _sent; }
+    // an /events stream the server's holding open
+    bool          isEventStream(void) const;
+
+    int           code = 0;
+    std::string   body;
+    std::string   location;
+    bool          keepBody = true;
+    // frames received over an /events stream, and the last one's event and data
+    uint32_t      events = 0;
+    std::string   lastEvent;
+    std::string   lastData;
+
+    // the client's gone, cleared by AsyncClient on its way out
+    void          _detach(void) { _client = NULL; }
+
+  private:
+    AsyncClient  *_client = NULL;
+    size_t        _sent = 0;
+    bool          _started = false;
+};
+
+}
+
+#endif
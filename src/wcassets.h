@@ -0,0 +1,95 @@
+/* Generated by extras/gen_assets.py from extras/assets, do not edit by hand */
+
+#ifndef WCAssets_h
+#define WCAssets_h
+
+#include <Arduino.h>
+
+// s.css: 673 bytes, 502 gzipped
+#define WC_STYLE_HASH "2a7024e6"
+const uint8_t WC_STYLE_GZ[] PROGMEM = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x6d, 0x52, 0x5d, 0x73, 0xa2, 0x30,
+    0x14, 0xfd, 0x2b, 0x4c, 0x77, 0x76, 0x66, 0x77, 0xa6, 0x28, 0x2a, 0xda, 0x82, 0xd3, 0x07, 0xa0,
+    0xd4, 0x6a, 0xfd, 0xa6, 0x50, 0xcb, 0x5b, 0x20, 0x21, 0x44, 0x20, 0xc1, 0x18, 0x04, 0x75, 0xfa,
+    0xdf, 0x17, 0xb4, 0x3b, 0xeb, 0xc3, 0xe6, 0x25, 0xf7, 0xe3, 0x9c, 0x7b, 0xcf, 0x9d, 0x7b, 0x5b,
+    0xe1, 0x59, 0xa0, 0x4a, 0xc8, 0x20, 0x25, 0x98, 0xea, 0x52, 0x88, 0xa8, 0x40, 0x7c, 0xf8, 0x25,
+    0x41, 0x72, 0xb8, 0x27, 0x34, 0x2f, 0xc4, 0x39, 0x07, 0x10, 0x12, 0x8a, 0xf5, 0x7e, 0x5e, 0x0d,
+    0x23, 0x46, 0x85, 0xbc, 0x27, 0x27, 0xa4, 0x77, 0x50, 0x56, 0xa3, 0xae, 0x88, 0x92, 0x40, 0x11,
+    0xeb, 0x5a, 0xff, 0x67, 0x1d, 0x09, 0x18, 0x3c, 0xfe, 0xaf, 0xe2, 0x85, 0x19, 0x81, 0x8c, 0xa4,
+    0x47, 0xfd, 0x80, 0x38, 0x04, 0x14, 0x34, 0xe8, 0x42, 0x08, 0x46, 0xcf, 0x01, 0xe3, 0x10, 0x71,
+    0x5d, 0x19, 0x5e, 0x0d, 0x99, 0x03, 0x48, 0x8a, 0xbd, 0xae, 0xb4, 0x7a, 0xbc, 0x6e, 0x13, 0x80,
+    0x30, 0xc1, 0x9c, 0x15, 0x14, 0xca, 0x21, 0x4b, 0x19, 0xd7, 0x7f, 0x74, 0x22, 0xd0, 0x43, 0xe1,
+    0xf0, 0xdb, 0x8b, 0xa2, 0x68, 0x98, 0x12, 0x8a, 0xe4, 0x18, 0x11, 0x1c, 0x0b, 0xbd, 0xdb, 0x52,
+    0x1b, 0xda, 0x8d, 0xd6, 0x56, 0xb7, 0x09, 0x5c, 0x65, 0x76, 0x14, 0xa5, 0xd1, 0xd9, 0xda, 0x9d,
+    0xa3, 0x94, 0x01, 0xa1, 0x4b, 0xbc, 0x21, 0x7d, 0x27, 0xa5, 0x81, 0x5a, 0x4f, 0x79, 0x2b, 0xff,
+    0x9a, 0xad, 0xf1, 0xe9, 0xf9, 0x9f, 0x0e, 0x5d, 0x2a, 0x78, 0xfa, 0xeb, 0x0e, 0x02, 0x01, 0x74,
+    0x92, 0x01, 0x8c, 0xda, 0x39, 0xc5, 0xb5, 0xce, 0x3d, 0x1a, 0xa8, 0xf7, 0xc4, 0x33, 0x17, 0xeb,
+    0x52, 0x79, 0x1b, 0x61, 0x66, 0xd4, 0x6f, 0xee, 0xb8, 0xb1, 0xed, 0xe2, 0xda, 0xb2, 0x1a, 0xd7,
+    0xc0, 0x96, 0x31, 0xab, 0x3f, 0xd3, 0xce, 0xc7, 0x7c, 0xd4, 0x04, 0xa6, 0x9e, 0x39, 0xf3, 0xec,
+    0x4d, 0xbb, 0xdd, 0x7e, 0xb4, 0xcd, 0x32, 0x32, 0xcb, 0xfd, 0xb4, 0x7c, 0x5c, 0x1a, 0xa7, 0xf9,
+    0x16, 0x58, 0x58, 0x9d, 0xbf, 0x7b, 0x9e, 0xbb, 0x9d, 0x10, 0xff, 0x79, 0xed, 0xba, 0xee, 0x4b,
+    0x05, 0x89, 0x3f, 0x72, 0x62, 0x36, 0x58, 0x38, 0x49, 0x7f, 0x89, 0x55, 0xf4, 0x72, 0x84, 0xaf,
+    0xef, 0xd6, 0x16, 0x44, 0xbd, 0xa6, 0x96, 0x6f, 0xa7, 0xf6, 0xca, 0x5b, 0xa9, 0x5b, 0xd4, 0x9d,
+    0x3b, 0xe5, 0x83, 0x31, 0x36, 0x62, 0xdb, 0x04, 0xd9, 0x1b, 0xd5, 0x1e, 0xda, 0xc5, 0x6c, 0x63,
+    0x8f, 0xcc, 0x03, 0x3b, 0x25, 0x1f, 0x81, 0x66, 0x75, 0xfd, 0x4a, 0xad, 0x4e, 0x1f, 0xc7, 0xc4,
+    0x8c, 0x5f, 0x0c, 0xf4, 0x99, 0x6b, 0x38, 0x99, 0x1e, 0x7d, 0x5b, 0x39, 0x8d, 0x67, 0x94, 0x69,
+    0x54, 0xc5, 0x1d, 0x2d, 0xce, 0xe0, 0x67, 0x4f, 0xdb, 0x87, 0xe5, 0xce, 0x4b, 0x16, 0x1b, 0x50,
+    0xe5, 0xb1, 0xe2, 0x5b, 0x9b, 0x55, 0xb8, 0xab, 0x9c, 0x1c, 0xaf, 0xf2, 0xc5, 0x1c, 0xf4, 0xb5,
+    0x32, 0x59, 0x3f, 0x2f, 0xa6, 0x5a, 0x0f, 0x19, 0x9b, 0x03, 0xc9, 0xca, 0x34, 0x58, 0x06, 0x65,
+    0xe9, 0x19, 0x08, 0x4f, 0x9d, 0xce, 0xeb, 0x28, 0xf2, 0x2f, 0x23, 0x9b, 0x93, 0xb5, 0xdb, 0xb7,
+    0x79, 0x32, 0xc1, 0x18, 0x3f, 0x3d, 0xdd, 0xfd, 0x96, 0x28, 0x93, 0x39, 0xca, 0x11, 0x10, 0x52,
+    0x8a, 0x22, 0xf1, 0xf7, 0x44, 0x6e, 0xf6, 0x7c, 0x59, 0x9b, 0x74, 0xb9, 0xb1, 0x3f, 0x67, 0xd4,
+    0xca, 0xf1, 0xa1, 0x02, 0x00, 0x00,
+};
+
+// s.js: 1513 bytes, 708 gzipped
+#define WC_SCRIPT_HASH "dbd7d1bd"
+const uint8_t WC_SCRIPT_GZ[] PROGMEM = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x7d, 0x54, 0x51, 0x4f, 0xdb, 0x30,
+    0x10, 0x7e, 0xdf, 0xaf, 0x28, 0x9a, 0x86, 0x6d, 0xb5, 0x98, 0xc2, 0xe3, 0x32, 0x6b, 0xda, 0x50,
+    0x35, 0x98, 0xa0, 0x4c, 0xd0, 0xa1, 0x49, 0xa8, 0x0f, 0xae, 0x7d, 0xa1, 0x1e, 0xa9, 0x93, 0xda,
+    0x4e, 0x5b, 0xd4, 0xf4, 0xbf, 0xef, 0x9c, 0x94, 0x96, 0x32, 0x4a, 0x5e, 0x92, 0xf8, 0x7c, 0xdf,
+    0x9d, 0xbf, 0xef, 0x3b, 0xa7, 0xa5, 0x55, 0xc1, 0xe4, 0xb6, 0xa5, 0x68, 0xc6, 0x96, 0x3a, 0x57,
+    0xe5, 0x04, 0x6c, 0xe0, 0x0f, 0x10, 0x7a, 0x19, 0xc4, 0xcf, 0xef, 0x4f, 0x17, 0x9a, 0x12, 0x4f,
+    0x18, 0x9f, 0xc9, 0xac, 0x04, 0x91, 0x71, 0x63, 0x2d, 0xb8, 0x01, 0x2c, 0x42, 0x55, 0x65, 0x3c,
+    0xe0, 0xfb, 0x2c, 0xb7, 0x01, 0x77, 0x26, 0x7b, 0xb3, 0x0b, 0xcc, 0x4e, 0x31, 0xe8, 0x29, 0x4b,
+    0x56, 0x1f, 0xd2, 0xe7, 0x92, 0x29, 0x95, 0x6c, 0x39, 0x93, 0xae, 0x65, 0xc5, 0xde, 0x54, 0x4b,
+    0x58, 0x62, 0x52, 0x7a, 0x60, 0x99, 0x83, 0x50, 0x3a, 0x9b, 0xd8, 0xa6, 0xfe, 0xf9, 0xe0, 0xea,
+    0x52, 0x10, 0x92, 0x48, 0x04, 0x76, 0x3d, 0xa9, 0xc6, 0xf4, 0x19, 0x96, 0x42, 0x03, 0xaa, 0xb7,
+    0xa0, 0xca, 0x81, 0x0c, 0xb0, 0xc6, 0xa5, 0x44, 0x9b, 0x19, 0x61, 0x9d, 0x6c, 0x6f, 0x5c, 0x62,
+    0x74, 0xba, 0x37, 0xea, 0x0b, 0x19, 0x9b, 0xca, 0xf8, 0xd8, 0x41, 0x2a, 0xc8, 0xc7, 0x82, 0xe0,
+    0x77, 0x6e, 0x55, 0x66, 0xd4, 0xa3, 0xd8, 0x34, 0xc1, 0x96, 0x91, 0xd0, 0x55, 0xb2, 0xc3, 0x90,
+    0x80, 0xfb, 0xee, 0x30, 0x99, 0x72, 0x95, 0x49, 0xef, 0xfb, 0x72, 0x02, 0xb8, 0x70, 0x3a, 0xfc,
+    0x4a, 0xa6, 0xad, 0x8c, 0x7c, 0x26, 0x53, 0x82, 0xa1, 0xdd, 0xdd, 0x27, 0xc3, 0x36, 0xf9, 0x44,
+    0x12, 0xcd, 0x65, 0x51, 0x80, 0xd5, 0x67, 0x63, 0x93, 0x69, 0x84, 0x7d, 0xb5, 0xf0, 0xaa, 0xd3,
+    0x28, 0x4d, 0x3f, 0xd7, 0x40, 0x49, 0x8b, 0xb0, 0xd7, 0x7b, 0xa7, 0x0c, 0x19, 0xdc, 0x49, 0x46,
+    0x49, 0x76, 0x54, 0x71, 0xb4, 0xe1, 0x6f, 0x21, 0x2c, 0xcc, 0x5b, 0x7f, 0xae, 0x2e, 0xcf, 0x43,
+    0x28, 0x6e, 0x60, 0x5a, 0x82, 0x0f, 0xa8, 0xdf, 0x02, 0xcf, 0x9a, 0xe5, 0x52, 0xbf, 0x3c, 0x2a,
+    0x0a, 0xb4, 0xe0, 0x3e, 0xc8, 0x50, 0x7a, 0x21, 0x4e, 0xbb, 0x5d, 0x96, 0xd2, 0x9f, 0xb7, 0xd7,
+    0x7d, 0x5e, 0x48, 0xe7, 0x01, 0x43, 0x0e, 0x7c, 0x91, 0x5b, 0x5f, 0x77, 0x86, 0x1d, 0xad, 0x22,
+    0x08, 0x76, 0x40, 0xc9, 0x8f, 0xde, 0x80, 0x74, 0xc8, 0xb1, 0x57, 0x35, 0xa5, 0x88, 0x81, 0x6d,
+    0xd5, 0x1e, 0x99, 0x1b, 0xab, 0xf3, 0xf9, 0xdb, 0xa5, 0xd6, 0xb1, 0xbb, 0xaa, 0x3a, 0xa0, 0xef,
+    0xf9, 0xa6, 0xaa, 0xf6, 0xdb, 0x39, 0x20, 0x33, 0xcf, 0x8e, 0x8a, 0xf6, 0x5a, 0x63, 0xf6, 0x66,
+    0xb8, 0xe5, 0x36, 0x2f, 0x9d, 0x82, 0xba, 0xd4, 0x7b, 0xf0, 0xcc, 0x43, 0xb8, 0x40, 0xa1, 0x1c,
+    0xce, 0x05, 0x75, 0x9d, 0x93, 0x2e, 0x3e, 0x2c, 0x59, 0x63, 0xae, 0xee, 0x6a, 0xf6, 0x5e, 0xe0,
+    0x51, 0x72, 0x0c, 0xf1, 0x0f, 0x27, 0x29, 0xb9, 0xe3, 0x52, 0xeb, 0x3a, 0x76, 0x69, 0x3c, 0x4a,
+    0x0d, 0x0e, 0x5b, 0x8a, 0x1c, 0x74, 0x36, 0x27, 0x9d, 0xb0, 0xe5, 0x0e, 0x89, 0x13, 0xae, 0x65,
+    0x90, 0x8c, 0xad, 0xf6, 0x64, 0xd7, 0xe4, 0xef, 0xe6, 0x47, 0x11, 0xbd, 0x78, 0x97, 0x83, 0x78,
+    0x76, 0xcf, 0xfc, 0x8e, 0xeb, 0x9a, 0x4a, 0xb5, 0x29, 0x92, 0xad, 0x2b, 0xe6, 0x34, 0x6d, 0x10,
+    0x41, 0xa4, 0x1c, 0x1a, 0x1c, 0xdf, 0x19, 0x89, 0xfb, 0x61, 0x67, 0x8f, 0x51, 0x70, 0x2e, 0x69,
+    0x4c, 0x30, 0xa2, 0x9b, 0x98, 0x2f, 0xc0, 0x33, 0xb0, 0x0f, 0x61, 0x9c, 0x98, 0x76, 0xbb, 0x01,
+    0x8a, 0xfe, 0x36, 0xc3, 0x9a, 0xfd, 0xc0, 0x2d, 0x0e, 0x43, 0x55, 0x51, 0x1a, 0x78, 0x78, 0x2a,
+    0x40, 0x08, 0xa2, 0xc6, 0xa0, 0x1e, 0x47, 0xf9, 0x82, 0x54, 0xd5, 0x66, 0xcd, 0x49, 0x6d, 0x72,
+    0xc2, 0x0e, 0x0f, 0x31, 0xa1, 0x8e, 0x83, 0x66, 0x4c, 0x61, 0xdb, 0xc6, 0x96, 0x90, 0x8c, 0x78,
+    0x51, 0xfa, 0x31, 0x05, 0xab, 0xd0, 0xfb, 0xbf, 0x6f, 0x2e, 0xce, 0xf2, 0x09, 0x9a, 0x2e, 0x8e,
+    0x6c, 0x03, 0xcf, 0xda, 0x44, 0x90, 0xf6, 0x9b, 0xe1, 0xfa, 0x66, 0x8b, 0xc6, 0x7c, 0xcb, 0xdc,
+    0x1b, 0x02, 0x6b, 0xcb, 0xb2, 0xed, 0x2d, 0x37, 0x77, 0x26, 0xfc, 0xe7, 0xee, 0x6d, 0x58, 0x65,
+    0x39, 0xea, 0xf6, 0xd2, 0xed, 0xbf, 0xae, 0x6f, 0xd1, 0xee, 0x69, 0x54, 0xe2, 0x5b, 0x08, 0xce,
+    0x8c, 0x4a, 0xcc, 0x27, 0xb2, 0x2e, 0x14, 0x27, 0x35, 0xfa, 0x3f, 0xac, 0x09, 0x3c, 0x07, 0xa9,
+    0xa3, 0xb0, 0x6b, 0x55, 0x8e, 0x06, 0x48, 0x01, 0x8e, 0x0a, 0x4e, 0x2e, 0xde, 0x33, 0x32, 0x66,
+    0x1c, 0x2f, 0x8e, 0xe6, 0xea, 0x08, 0x59, 0x9e, 0x6c, 0x47, 0x67, 0xc4, 0xff, 0xe6, 0x06, 0x2b,
+    0x1d, 0x46, 0xb8, 0xc6, 0x8a, 0xad, 0x54, 0x66, 0x1e, 0x92, 0xd5, 0x3f, 0xd5, 0xb1, 0xea, 0xe1,
+    0xe9, 0x05, 0x00, 0x00,
+};
+
+#endif
@@ -0,0 +1,92 @@
+#include "wcdns.h"
+
+#define DNS_HEADER_LEN      12
+#define DNS_TYPE_A          1
+#define DNS_TYPE_ANY        255
+#define DNS_CLASS_IN        1
+
+bool WIFIConfigDNS::start(uint16_t port, const IPAddress &ip) {
+    // the answer never changes, so it's built once with the address patched in
+    const uint8_t answer[] = {
+        0xC0, 0x0C,                             // pointer to the name in the question
+        0x00, DNS_TYPE_A, 0x00, DNS_CLASS_IN,
+        0x00, 0x00, 0x00, WC_DNS_TTL,
+        0x00, 0x04,
+        ip[0], ip[1], ip[2], ip[3]
+    };
+    memcpy(_answer, answer, sizeof(_answer));
+
+    return _udp.begin(port) == 1;
+}
+
+void WIFIConfigDNS::stop(void) {
+    _udp.stop();
+}
+
+uint16_t WIFIConfigDNS::processRequests(uint16_t budget) {
+    uint16_t handled = 0;
+
+    while (handled < budget) {
+        int len = _udp.parsePacket();
+        if (len <= 0)
+            break;
+        handled++;
+
+        if (len > WC_DNS_MAX_QUERY) {
+            _udp.flush();
+            continue;
+        }
+        _udp.read(_buf, len);
+
+        size_t out = respond(len);
+        if (out == 0)
+            continue;
+
+        _udp.beginPacket(_udp.remoteIP(), _udp.remotePort());
+        _udp.write(_buf, out);
+        _udp.endPacket();
+    }
+
+    return handled;
+}
+
+/* turn the query in _buf into its response, in place. Returns the response length, 0 to drop it */
+size_t WIFIConfigDNS::respond(size_t len) {
+    if (len < DNS_HEADER_LEN)
+        return 0;
+
+    // only standard queries with a single question
+    if ((_buf[2] & 0x80) != 0 || ((_buf[2] >> 3) & 0x0F) != 0)
+        return 0;
+    if (_buf[4] != 0 || _buf[5] != 1)
+        return 0;
+
+    // skip over the name, labels only, queries don't use compression
+    size_t pos = DNS_HEADER_LEN;
+    while (pos < len && _buf[pos] != 0) {
+        if ((_buf[pos] & 0xC0) != 0)
+            return 0;
+        pos += _buf[pos] + 1;
+    }
+    pos += 1 + 4;   // terminating zero, type, class
+    if (pos > len)
+        return 0;
+
+    uint16_t qtype = (_buf[pos - 4] << 8) | _buf[pos - 3];
+    uint16_t qclass = (_buf[pos - 2] << 8) | _buf[pos - 1];
+
+    // response, authoritative, recursion desired copied over, no error
+    _buf[2] = 0x84 | (_buf[2] & 0x01);
+    _buf[3] = 0x00;
+    // answer count, and drop any authority/additional records (EDNS etc.) along with the rest of the query
+    memset(_buf + 6, 0, 6);
+
+    if ((qtype == DNS_TYPE_A || qtype == DNS_TYPE_ANY) && qclass == DNS_CLASS_IN) {
+        _buf[7] = 1;
+        memcpy(_buf + pos, _answer, sizeof(_answer));
+        return pos + sizeof(_answer);
+    }
+
+    // AAAA, HTTPS and the rest: no records, but no error either, so there's nothing to retry
+    return pos;
+}
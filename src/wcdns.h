@@ -0,0 +1,38 @@
+/**************************************************************
+   Captive DNS responder for WIFIConfig.
+   Answers every A query with the AP's address and every other query type
+   with an empty NOERROR, so clients neither retry nor wait on a timeout.
+   Pending queries are drained in batches rather than one per loop pass.
+ **************************************************************/
+
+#ifndef WCDNS_h
+#define WCDNS_h
+
+#include <Arduino.h>
+#include <WiFiUdp.h>
+
+// max queries answered per processRequests() call
+#if !defined(WC_DNS_BUDGET)
+    #define WC_DNS_BUDGET       8
+#endif
+
+// largest query handled, anything bigger is dropped
+#define WC_DNS_MAX_QUERY        256
+#define WC_DNS_TTL              60
+
+class WIFIConfigDNS {
+  public:
+    bool          start(uint16_t port, const IPAddress &ip);
+    void          stop(void);
+    // answer up to 'budget' pending queries, returns how many were handled
+    uint16_t      processRequests(uint16_t budget = WC_DNS_BUDGET);
+  private:
+    WiFiUDP       _udp;
+    // answer record for A queries: name pointer, type, class, TTL, length, then the AP address
+    uint8_t       _answer[16];
+    uint8_t       _buf[WC_DNS_MAX_QUERY + sizeof(_answer)];
+
+    size_t        respond(size_t len);
+};
+
+#endif
@@ -0,0 +1,60 @@
+#include "wcfast.h"
+
+#if defined(ARDUINO_ARCH_ESP8266)
+    #include <ESP8266WiFi.h>
+#elif defined(ARDUINO_ARCH_ESP32)
+    #include <WiFi.h>
+#endif
+
+static_assert(sizeof(WCFastRecord) % 4 == 0, "RTC memory is read and written in 4-byte blocks");
+
+#if defined(ARDUINO_ARCH_ESP32)
+// left alone by the startup code, so it keeps its contents across resets and deep sleep
+static RTC_NOINIT_ATTR WCFastRecord wc_rtc_record;
+#endif
+
+// plain bitwise CRC-32, the record's too small to be worth a table
+uint32_t wc_crc32(const void *data, size_t len, uint32_t crc) {
+    const uint8_t *p = (const uint8_t *)data;
+    crc = ~crc;
+    while (len--) {
+        crc ^= *p++;
+        for (uint8_t i = 0; i < 8; i++)
+            crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+    }
+    return ~crc;
+}
+
+static uint32_t recordCRC(const WCFastRecord *rec) {
+    return wc_crc32((const uint8_t *)rec + sizeof(rec->crc), sizeof(*rec) - sizeof(rec->crc));
+}
+
+bool wc_fast_load(WCFastRecord *rec) {
+#if defined(ARDUINO_ARCH_ESP8266)
+    if (!ESP.rtcUserMemoryRead(WC_FAST_RTC_OFFSET, (uint32_t *)rec, sizeof(*rec)))
+        return false;
+#elif defined(ARDUINO_ARCH_ESP32)
+    memcpy(rec, &wc_rtc_record, sizeof(*rec));
+#endif
+    return rec->version == WC_FAST_VERSION && rec->crc == recordCRC(rec);
+}
+
+void wc_fast_save(WCFastRecord *rec) {
+    rec->version = WC_FAST_VERSION;
+    rec->crc = recordCRC(rec);
+#if defined(ARDUINO_ARCH_ESP8266)
+    ESP.rtcUserMemoryWrite(WC_FAST_RTC_OFFSET, (uint32_t *)rec, sizeof(*rec));
+#elif defined(ARDUINO_ARCH_ESP32)
+    memcpy(&wc_rtc_record, rec, sizeof(*rec));
+#endif
+}
+
+void wc_fast_clear(void) {
+    WCFastRecord rec;
+    memset(&rec, 0, sizeof(rec));
+#if defined(ARDUINO_ARCH_ESP8266)
+    ESP.rtcUserMemoryWrite(WC_FAST_RTC_OFFSET, (uint32_t *)&rec, sizeof(rec));
+#elif defined(ARDUINO_ARCH_ESP32)
+    memcpy(&wc_rtc_record, &rec, sizeof(rec));
+#endif
+}
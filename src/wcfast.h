@@ -0,0 +1,42 @@
+/**************************************************************
+   Fast reconnect record for WIFIConfig.
+   Remembers the BSSID and channel of the AP last connected to, and optionally
+   the DHCP lease, in RTC memory, so the next connect can skip the scan (and
+   DHCP). The record survives resets and deep sleep but not a power cycle; a
+   CRC catches whatever RTC memory holds after one.
+ **************************************************************/
+
+#ifndef WCFast_h
+#define WCFast_h
+
+#include <Arduino.h>
+
+// where the record sits in RTC user memory, in 4-byte blocks (ESP8266 only)
+#if !defined(WC_FAST_RTC_OFFSET)
+    #define WC_FAST_RTC_OFFSET  32
+#endif
+
+#define WC_FAST_VERSION         1
+
+struct WCFastRecord {
+    uint32_t      crc;          // over everything after it
+    uint32_t      version;
+    uint32_t      credHash;     // SSID and passkey the record is good for
+    uint8_t       bssid[6];
+    uint8_t       channel;
+    uint8_t       hasLease;     // the addresses below are valid
+    uint32_t      ip;
+    uint32_t      gateway;
+    uint32_t      subnet;
+    uint32_t      dns;
+};
+
+uint32_t wc_crc32(const void *data, size_t len, uint32_t crc = 0);
+
+// false if there's no valid record
+bool wc_fast_load(WCFastRecord *rec);
+// sets the version and CRC before storing it
+void wc_fast_save(WCFastRecord *rec);
+void wc_fast_clear(void);
+
+#endif
@@ -0,0 +1,277 @@
+#include "wcform.h"
+
+static int8_t hexValue(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+void WCFormParser::begin(WCFieldSink *fieldSink) {
+    memset(this, 0, sizeof(*this));
+    sink = fieldSink;
+}
+
+void WCFormParser::parse(const uint8_t *data, size_t dataLen) {
+    for (size_t i = 0; i < dataLen; i++) {
+        char c = data[i];
+
+        if (c == '&') {
+            endField();
+            continue;
+        }
+        if (c == '=' && !inValue) {
+            startValue();
+            continue;
+        }
+
+        if (pct == 0) {
+            if (c == '%') {
+                pct = 1;
+                continue;
+            }
+            if (c == '+')
+                c = ' ';
+        }
+        else {
+            int8_t v = hexValue(c);
+            if (v < 0) {
+                // malformed escape, drop it
+                pct = 0;
+                continue;
+            }
+            if (pct == 1) {
+                hi = v;
+                pct = 2;
+                continue;
+            }
+            c = (hi << 4) | v;
+            pct = 0;
+        }
+
+        put(c);
+    }
+}
+
+void WCFormParser::finish(void) {
+    endField();
+}
+
+void WCFormParser::put(char c) {
+    if (!inValue) {
+        if (keyLen < sizeof(key))
+            key[keyLen++] = c;
+        else
+            keyTooLong = true;
+        return;
+    }
+
+    if (dst == NULL)
+        return;
+    if (len < cap) {
+        dst[len++] = c;
+        // kept terminated all along, in case the body never completes
+        dst[len] = 0;
+    } else {
+        truncated = true;
+    }
+}
+
+void WCFormParser::startValue(void) {
+    inValue = true;
+    pct = 0;
+    len = 0;
+    truncated = false;
+    dst = keyTooLong ? NULL : sink->fieldBuffer(key, keyLen, &cap);
+    if (dst != NULL)
+        dst[0] = 0;
+}
+
+void WCFormParser::endField(void) {
+    // a bare name with no '=' counts as an empty value
+    if (!inValue && keyLen > 0)
+        startValue();
+
+    if (inValue)
+        sink->fieldDone(key, keyLen, dst != NULL, truncated);
+
+    keyLen = 0;
+    keyTooLong = false;
+    inValue = false;
+    pct = 0;
+    dst = NULL;
+}
+
+void WCJSONParser::begin(WCFieldSink *fieldSink) {
+    memset(this, 0, sizeof(*this));
+    sink = fieldSink;
+    state = J_START;
+}
+
+static bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+void WCJSONParser::parse(const uint8_t *data, size_t dataLen) {
+    for (size_t i = 0; i < dataLen && state != J_ERROR; i++) {
+        char c = data[i];
+
+        switch (state) {
+            case J_START:
+                if (c == '{')
+                    state = J_KEY_OR_END;
+                else if (!isSpace(c))
+                    state = J_ERROR;
+                break;
+
+            case J_KEY_OR_END:
+                if (c == '"') {
+                    keyLen = 0;
+                    keyTooLong = false;
+                    state = J_KEY;
+                }
+                else if (c == '}')
+                    state = J_DONE;
+                else if (!isSpace(c))
+                    state = J_ERROR;
+                break;
+
+            case J_KEY:
+            case J_STRING:
+                if (esc == 0) {
+                    if (c == '\\')
+                        esc = 1;
+                    else if (c == '"')
+                        endString();
+                    else if ((uint8_t)c < 0x20)
+                        state = J_ERROR;
+                    else
+                        put(c);
+                }
+                else if (esc == 1) {
+                    esc = 0;
+                    switch (c) {
+                        case 'b': put('\b'); break;
+                        case 'f': put('\f'); break;
+                        case 'n': put('\n'); break;
+                        case 'r': put('\r'); break;
+                        case 't': put('\t'); break;
+                        case 'u': esc = 2; code = 0; break;
+                        default:  put(c); break;
+                    }
+                }
+                else {
+                    int8_t v = hexValue(c);
+                    if (v < 0) {
+                        state = J_ERROR;
+                        break;
+                    }
+                    code = (code << 4) | v;
+                    if (++esc == 6) {
+                        esc = 0;
+                        putCode(code);
+                    }
+                }
+                break;
+
+            case J_COLON:
+                if (c == ':')
+                    state = J_VALUE;
+                else if (!isSpace(c))
+                    state = J_ERROR;
+                break;
+
+            case J_VALUE:
+                if (c == '"') {
+                    len = 0;
+                    truncated = false;
+                    dst = keyTooLong ? NULL : sink->fieldBuffer(key, keyLen, &cap);
+                    if (dst != NULL)
+                        dst[0] = 0;
+                    state = J_STRING;
+                }
+                else if (c == '{' || c == '[')
+                    state = J_ERROR;
+                else if (!isSpace(c)) {
+                    // not a string, the field is reported but not stored
+                    sink->fieldDone(key, keyLen, false, false);
+                    state = J_SCALAR;
+                }
+                break;
+
+            case J_SCALAR:
+                if (c == ',')
+                    state = J_KEY_OR_END;
+                else if (c == '}')
+                    state = J_DONE;
+                else if (c == '"' || c == '{' || c == '[')
+                    state = J_ERROR;
+                break;
+
+            case J_NEXT:
+                if (c == ',')
+                    state = J_KEY_OR_END;
+                else if (c == '}')
+                    state = J_DONE;
+                else if (!isSpace(c))
+                    state = J_ERROR;
+                break;
+
+            case J_DONE:
+                if (!isSpace(c))
+                    state = J_ERROR;
+                break;
+        }
+    }
+}
+
+bool WCJSONParser::finish(void) {
+    return state == J_DONE;
+}
+
+void WCJSONParser::put(char c) {
+    if (state == J_KEY) {
+        if (keyLen < sizeof(key))
+            key[keyLen++] = c;
+        else
+            keyTooLong = true;
+        return;
+    }
+
+    if (dst == NULL)
+        return;
+    if (len < cap) {
+        dst[len++] = c;
+        dst[len] = 0;
+    } else {
+        truncated = true;
+    }
+}
+
+// \uXXXX escapes go out as UTF-8, surrogate halves included as-is
+void WCJSONParser::putCode(uint16_t c) {
+    if (c < 0x80) {
+        put(c);
+    } else if (c < 0x800) {
+        put(0xC0 | (c >> 6));
+        put(0x80 | (c & 0x3F));
+    } else {
+        put(0xE0 | (c >> 12));
+        put(0x80 | ((c >> 6) & 0x3F));
+        put(0x80 | (c & 0x3F));
+    }
+}
+
+void WCJSONParser::endString(void) {
+    if (state == J_KEY) {
+        state = J_COLON;
+        return;
+    }
+
+    sink->fieldDone(key, keyLen, dst != NULL, truncated);
+    dst = NULL;
+    state = J_NEXT;
+}
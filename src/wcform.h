@@ -0,0 +1,91 @@
+/**************************************************************
+   Incremental form decoders for WIFIConfig.
+   Decode an application/x-www-form-urlencoded body, or a flat JSON object
+   of strings, as it arrives, chunk by chunk, unescaping each value straight
+   into the buffer its field maps to. Nothing is buffered beyond the
+   current field name.
+ **************************************************************/
+
+#ifndef WCForm_h
+#define WCForm_h
+
+#include <Arduino.h>
+
+// longest field name recognised, longer ones are dropped along with their values
+#define WC_FORM_MAX_KEY     32
+
+// maps field names to destination buffers
+class WCFieldSink {
+  public:
+    // buffer for the value of field 'key' (not nul-terminated), with room for 'cap' chars plus a nul,
+    // or NULL to drop the field
+    virtual char *fieldBuffer(const char *key, size_t keyLen, size_t *cap) = 0;
+    // called once the field's value is complete, 'truncated' if it didn't fit.
+    // 'stored' is false if the field was dropped, or (JSON only) its value wasn't a string
+    virtual void  fieldDone(const char *, size_t, bool, bool) {}
+};
+
+/* Plain data, so it can live in a request's _tempObject and be released with free() */
+struct WCFormParser {
+    WCFieldSink  *sink;
+    char          key[WC_FORM_MAX_KEY];
+    uint8_t       keyLen;
+    bool          keyTooLong;
+    bool          inValue;
+    uint8_t       pct;          // 0, or how much of a %XX escape has been seen
+    uint8_t       hi;
+    char         *dst;
+    size_t        cap;
+    size_t        len;
+    bool          truncated;
+
+    void          begin(WCFieldSink *fieldSink);
+    void          parse(const uint8_t *data, size_t dataLen);
+    // flush the last field at the end of the body
+    void          finish(void);
+
+  private:
+    void          put(char c);
+    void          startValue(void);
+    void          endField(void);
+};
+
+/* Same idea for a flat JSON object, {"name":"value",...}. Values must be strings */
+struct WCJSONParser {
+    enum {
+        J_START,            // before the opening brace
+        J_KEY_OR_END,
+        J_KEY,
+        J_COLON,
+        J_VALUE,
+        J_STRING,
+        J_SCALAR,           // number/true/false/null, skipped
+        J_NEXT,             // after a value: comma or closing brace
+        J_DONE,
+        J_ERROR,
+    };
+
+    WCFieldSink  *sink;
+    char          key[WC_FORM_MAX_KEY];
+    uint8_t       keyLen;
+    bool          keyTooLong;
+    uint8_t       state;
+    uint8_t       esc;          // 0, 1 after a backslash, 2-5 while reading \uXXXX
+    uint16_t      code;
+    char         *dst;
+    size_t        cap;
+    size_t        len;
+    bool          truncated;
+
+    void          begin(WCFieldSink *fieldSink);
+    void          parse(const uint8_t *data, size_t dataLen);
+    // true if the body was a complete, well-formed object
+    bool          finish(void);
+
+  private:
+    void          put(char c);
+    void          putCode(uint16_t c);
+    void          endString(void);
+};
+
+#endif
@@ -0,0 +1,114 @@
+#include "wificonfig.h"
+
+#if WC_LOG_LEVEL > WC_LOG_NONE
+
+static_assert((WC_LOG_RECORDS & (WC_LOG_RECORDS - 1)) == 0, "WC_LOG_RECORDS must be a power of 2");
+
+#define WC_LOG_FORMAT(name, fmt)        static const char WC_EVF_##name[] PROGMEM = fmt;
+WC_LOG_EVENTS(WC_LOG_FORMAT)
+#define WC_LOG_FORMAT_PTR(name, fmt)    WC_EVF_##name,
+static const char * const WC_LOG_FORMATS[] PROGMEM = {
+    WC_LOG_EVENTS(WC_LOG_FORMAT_PTR)
+};
+
+struct WCLogRecord {
+    uint32_t      seq;          // index + 1 once the record's complete, so the drain knows it can have it
+    uint32_t      ms;
+    uintptr_t     a;            // pointer-sized, for %s
+    uintptr_t     b;
+    uint8_t       level;
+    uint8_t       event;
+};
+
+/* Any number of writers claim an index by bumping the head, fill the record in, then publish it
+ * by setting its seq. The drain is the only reader, and the only one moving the tail */
+static WCLogRecord wc_log_ring[WC_LOG_RECORDS];
+static uint32_t wc_log_head;
+static uint32_t wc_log_tail;
+static uint32_t wc_log_dropped;
+
+void wc_log(uint8_t level, uint8_t event, uintptr_t a, uintptr_t b) {
+    uint32_t head = __atomic_load_n(&wc_log_head, __ATOMIC_RELAXED);
+    do {
+        // full, never wait on the drain
+        if (head - __atomic_load_n(&wc_log_tail, __ATOMIC_ACQUIRE) >= WC_LOG_RECORDS) {
+            __atomic_add_fetch(&wc_log_dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    } while (!__atomic_compare_exchange_n(&wc_log_head, &head, head + 1, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    WCLogRecord *rec = &wc_log_ring[head & (WC_LOG_RECORDS - 1)];
+    rec->ms = millis();
+    rec->a = a;
+    rec->b = b;
+    rec->level = level;
+    rec->event = event;
+    __atomic_store_n(&rec->seq, head + 1, __ATOMIC_RELEASE);
+}
+
+// just enough printf for the event formats, which live in PROGMEM
+static size_t formatRecord(char *line, size_t cap, const WCLogRecord *rec) {
+    static const char levels[] = " EWID";
+    const char *fmt = (const char *)pgm_read_ptr(&WC_LOG_FORMATS[rec->event]);
+    uintptr_t args[2] = { rec->a, rec->b };
+    uint8_t arg = 0;
+
+    size_t len = snprintf(line, cap, "[%lu] %c ", (unsigned long)rec->ms, levels[rec->level]);
+    for (char c; (c = pgm_read_byte(fmt)) != 0 && len < cap - 1; fmt++) {
+        if (c != '%' || pgm_read_byte(fmt + 1) == 0) {
+            line[len++] = c;
+            continue;
+        }
+        c = pgm_read_byte(++fmt);
+        uintptr_t p = arg < 2 ? args[arg++] : 0;
+        uint32_t v = (uint32_t)p;
+        switch (c) {
+            case 'u': len += snprintf(line + len, cap - len, "%lu", (unsigned long)v); break;
+            case 'd': len += snprintf(line + len, cap - len, "%ld", (long)(int32_t)v); break;
+            case 'x': len += snprintf(line + len, cap - len, "%lx", (unsigned long)v); break;
+            case 's': len += snprintf(line + len, cap - len, "%s", p ? (const char *)p : ""); break;
+            case 'I': len += snprintf(line + len, cap - len, "%u.%u.%u.%u", (unsigned)(v & 0xFF),
+                                      (unsigned)((v >> 8) & 0xFF), (unsigned)((v >> 16) & 0xFF), (unsigned)(v >> 24)); break;
+            default:  line[len++] = c; arg--; break;
+        }
+        // snprintf reports what it would have written
+        if (len > cap - 1)
+            len = cap - 1;
+    }
+    if (len > cap - 3)
+        len = cap - 3;
+    line[len++] = '\r';
+    line[len++] = '\n';
+    return len;
+}
+
+void wc_log_drain(void) {
+    char line[WC_LOG_LINE];
+
+    uint32_t dropped = __atomic_exchange_n(&wc_log_dropped, 0, __ATOMIC_RELAXED);
+    if (dropped != 0 && WC_DEFAULT_STREAM.availableForWrite() < WC_LOG_LINE) {
+        // next time then
+        __atomic_add_fetch(&wc_log_dropped, dropped, __ATOMIC_RELAXED);
+    }
+    else if (dropped != 0) {
+        WCLogRecord rec = { 0, (uint32_t)millis(), dropped, 0, WC_LOG_WARN, WC_EV_RECORDS_DROPPED };
+        WC_DEFAULT_STREAM.write((const uint8_t *)line, formatRecord(line, sizeof(line), &rec));
+    }
+
+    uint32_t tail = wc_log_tail;
+    for (uint8_t n = 0; n < WC_LOG_DRAIN; n++) {
+        // only as much as fits in the UART's buffer, so this never blocks
+        if (WC_DEFAULT_STREAM.availableForWrite() < WC_LOG_LINE)
+            break;
+        WCLogRecord *slot = &wc_log_ring[tail & (WC_LOG_RECORDS - 1)];
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != tail + 1)
+            break;
+        WCLogRecord rec = *slot;
+        // the slot's free for writers again once it's been copied
+        __atomic_store_n(&wc_log_tail, ++tail, __ATOMIC_RELEASE);
+
+        WC_DEFAULT_STREAM.write((const uint8_t *)line, formatRecord(line, sizeof(line), &rec));
+    }
+}
+
+#endif
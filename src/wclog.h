@@ -0,0 +1,109 @@
+/**************************************************************
+   Deferred logger for WIFIConfig.
+   Logging an event just drops a small binary record (event, level, time and
+   two arguments) into a ring buffer, from any task, without locking or
+   formatting anything. wc_log_drain(), called from config_loop, formats the
+   records later, and only as fast as the output can take them without blocking.
+   Levels above WC_LOG_LEVEL compile to nothing.
+   Arguments are pointer-sized, so a string can go in as it is, but it's only
+   formatted when drained and must outlive that: literals, parameter IDs and
+   the like.
+ **************************************************************/
+
+#ifndef WCLog_h
+#define WCLog_h
+
+#include <Arduino.h>
+
+#define WC_LOG_NONE         0
+#define WC_LOG_ERROR        1
+#define WC_LOG_WARN         2
+#define WC_LOG_INFO         3
+#define WC_LOG_DEBUG        4
+
+// WC_ENABLE_DEBUG on its own means everything
+#if !defined(WC_LOG_LEVEL)
+    #if defined(WC_ENABLE_DEBUG)
+        #define WC_LOG_LEVEL    WC_LOG_DEBUG
+    #else
+        #define WC_LOG_LEVEL    WC_LOG_NONE
+    #endif
+#endif
+
+#if !defined(WC_DEFAULT_STREAM)
+    #define WC_DEFAULT_STREAM   Serial
+#endif
+
+// records held before new ones get dropped, a power of 2
+#if !defined(WC_LOG_RECORDS)
+    #define WC_LOG_RECORDS      32
+#endif
+// max records formatted per wc_log_drain() call
+#define WC_LOG_DRAIN        4
+// longest formatted line
+#define WC_LOG_LINE         96
+
+/* events and their formats. %u, %d, %x and %s take the next argument, %I an IPv4 address */
+#define WC_LOG_EVENTS(X) \
+    X(PARAMS_FULL,      "max parameters exceeded, use a WIFIConfigT<N> with more room. Skipping '%s'") \
+    X(ARENA_FULL,       "value arena exhausted, use a WIFIConfigT with a bigger arena. Skipping '%s'") \
+    X(PARAM_ADDED,      "added parameter '%s'") \
+    X(AP_START,         "setting up AP, timeout %u ms") \
+    X(SERVER_STARTED,   "HTTP server started") \
+    X(AP_ADDRESS,       "AP address %I") \
+    X(RESTARTING,       "restarting") \
+    X(TIMEOUT,          "timed out, stopping servers") \
+    X(DONE,             "done, stopping servers") \
+    X(SERVER_KEPT,      "connections still open, keeping the server until they close") \
+    X(SAVE_FAILED,      "couldn't save the config") \
+    X(CONFIG_LOADED,    "loaded saved config, skipping the portal") \
+    X(CONNECTED,        "connected in %u ms") \
+    X(FAST_CONNECTED,   "fast connected in %u ms") \
+    X(CONNECT_FAILED,   "connect failed after %u ms") \
+    X(FAST_STALE,       "remembered AP didn't work, doing a full connect") \
+    X(SETTINGS_RESET,   "settings invalidated, this may stop the AP starting up properly until it's taken out") \
+    X(SCAN_DONE,        "scan found %u networks") \
+    X(PAGE_SENT,        "sent %s") \
+    X(NO_STAGE_MEMORY,  "no memory for staging submitted configs") \
+    X(PARAM_COMMITTED,  "parameter '%s': %u chars") \
+    X(API_CONFIG,       "config %s over the API") \
+    X(RECORDS_DROPPED,  "%u log records dropped")
+
+#define WC_LOG_ENUM(name, fmt)  WC_EV_##name,
+enum {
+    WC_LOG_EVENTS(WC_LOG_ENUM)
+    WC_EV_COUNT
+};
+#undef WC_LOG_ENUM
+
+#if WC_LOG_LEVEL > WC_LOG_NONE
+    void wc_log(uint8_t level, uint8_t event, uintptr_t a, uintptr_t b);
+    // format and print pending records, never more than the output has room for
+    void wc_log_drain(void);
+    #define WC_LOG_AT(level, ev, a, b)  wc_log(level, WC_EV_##ev, (uintptr_t)(a), (uintptr_t)(b))
+#else
+    #define wc_log_drain()              ((void)0)
+#endif
+
+#if WC_LOG_LEVEL >= WC_LOG_ERROR
+    #define WC_LOGE(ev, a, b)   WC_LOG_AT(WC_LOG_ERROR, ev, a, b)
+#else
+    #define WC_LOGE(ev, a, b)   ((void)0)
+#endif
+#if WC_LOG_LEVEL >= WC_LOG_WARN
+    #define WC_LOGW(ev, a, b)   WC_LOG_AT(WC_LOG_WARN, ev, a, b)
+#else
+    #define WC_LOGW(ev, a, b)   ((void)0)
+#endif
+#if WC_LOG_LEVEL >= WC_LOG_INFO
+    #define WC_LOGI(ev, a, b)   WC_LOG_AT(WC_LOG_INFO, ev, a, b)
+#else
+    #define WC_LOGI(ev, a, b)   ((void)0)
+#endif
+#if WC_LOG_LEVEL >= WC_LOG_DEBUG
+    #define WC_LOGD(ev, a, b)   WC_LOG_AT(WC_LOG_DEBUG, ev, a, b)
+#else
+    #define WC_LOGD(ev, a, b)   ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,125 @@
+#include "wificonfig.h"
+
+#if defined(WC_ENABLE_STORE)
+
+#include <LittleFS.h>
+
+#define WC_STORE_MAGIC      0x31464357UL    // "WCF1"
+
+bool WCStore::mount(void) {
+#if defined(ARDUINO_ARCH_ESP32)
+    // a blank partition gets formatted the first time round
+    return LittleFS.begin(true);
+#else
+    return LittleFS.begin();
+#endif
+}
+
+File WCStore::openSlot(uint8_t slot, const char *mode) {
+    char path[16];
+    snprintf(path, sizeof(path), WC_STORE_PATH, slot);
+    return LittleFS.open(path, mode);
+}
+
+// read a slot's header, and check its payload against the CRC. false if it's missing or damaged
+bool WCStore::checkSlot(uint8_t slot, WCStoreHeader *hdr) {
+    File f = openSlot(slot, "r");
+    if (!f)
+        return false;
+    bool ok = f.read((uint8_t *)hdr, sizeof(*hdr)) == sizeof(*hdr) && hdr->magic == WC_STORE_MAGIC
+              && f.size() >= sizeof(*hdr) + hdr->length;
+
+    uint8_t buf[32];
+    uint32_t crc = 0;
+    for (uint32_t left = hdr->length; ok && left > 0; ) {
+        size_t n = left < sizeof(buf) ? left : sizeof(buf);
+        ok = f.read(buf, n) == n;
+        crc = wc_crc32(buf, n, crc);
+        left -= n;
+    }
+    f.close();
+    return ok && crc == hdr->crc;
+}
+
+bool WCStore::openLatest(uint32_t schema) {
+    close();
+    if (!mount())
+        return false;
+
+    // newest intact record with the right schema
+    int best = -1;
+    WCStoreHeader hdr, bestHdr;
+    for (uint8_t i = 0; i < WC_STORE_SLOTS; i++) {
+        if (!checkSlot(i, &hdr) || hdr.schema != schema)
+            continue;
+        if (best < 0 || (int32_t)(hdr.seq - bestHdr.seq) > 0) {
+            best = i;
+            bestHdr = hdr;
+        }
+    }
+    if (best < 0)
+        return false;
+
+    _file = openSlot(best, "r");
+    if (_file && _file.seek(sizeof(bestHdr)))
+        return true;
+    close();
+    return false;
+}
+
+bool WCStore::read(void *buf, size_t len) {
+    return _file && _file.read((uint8_t *)buf, len) == len;
+}
+
+bool WCStore::create(uint32_t schema, uint32_t length, uint32_t crc) {
+    close();
+    if (!mount())
+        return false;
+
+    // take an empty or damaged slot if there is one, otherwise the oldest, so the newest intact record always survives
+    int empty = -1, oldestSlot = -1;
+    uint32_t newest = 0, oldest = 0;
+    for (uint8_t i = 0; i < WC_STORE_SLOTS; i++) {
+        WCStoreHeader hdr;
+        if (!checkSlot(i, &hdr)) {
+            if (empty < 0)
+                empty = i;
+            continue;
+        }
+        if (oldestSlot < 0 || (int32_t)(hdr.seq - newest) > 0)
+            newest = hdr.seq;
+        if (oldestSlot < 0 || (int32_t)(hdr.seq - oldest) < 0) {
+            oldest = hdr.seq;
+            oldestSlot = i;
+        }
+    }
+    uint8_t slot = empty >= 0 ? empty : oldestSlot;
+
+    WCStoreHeader hdr = { WC_STORE_MAGIC, oldestSlot >= 0 ? newest + 1 : 1, schema, length, crc };
+    _file = openSlot(slot, "w");
+    return write(&hdr, sizeof(hdr));
+}
+
+bool WCStore::write(const void *buf, size_t len) {
+    return _file && _file.write((const uint8_t *)buf, len) == len;
+}
+
+void WCStore::close(void) {
+    if (_file)
+        _file.close();
+    _file = File();
+}
+
+void WCStore::erase(void) {
+    close();
+    if (!mount())
+        return;
+    for (uint8_t i = 0; i < WC_STORE_SLOTS; i++) {
+        char path[16];
+        snprintf(path, sizeof(path), WC_STORE_PATH, i);
+        if (LittleFS.exists(path))
+            LittleFS.remove(path);
+    }
+}
+
+#endif
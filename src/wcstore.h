@@ -0,0 +1,45 @@
+/**************************************************************
+   Persistent config store for WIFIConfig, on LittleFS.
+   A record is a small header (sequence number, schema hash, payload length
+   and CRC) followed by the payload. Records rotate through WC_STORE_SLOTS
+   files, so a write that's cut short only ever loses the new record, never
+   the last good one; LittleFS does the wear leveling underneath.
+ **************************************************************/
+
+#ifndef WCStore_h
+#define WCStore_h
+
+#include <Arduino.h>
+#include <FS.h>
+
+#define WC_STORE_SLOTS      2
+#define WC_STORE_PATH       "/wcfg%u.bin"
+
+struct WCStoreHeader {
+    uint32_t      magic;
+    uint32_t      seq;          // bumped on every save, the highest valid one wins
+    uint32_t      schema;       // layout the payload was written with
+    uint32_t      length;       // of the payload
+    uint32_t      crc;          // of the payload
+};
+
+class WCStore {
+  public:
+    // open the newest record written with 'schema' whose payload checks out, ready for read()
+    bool          openLatest(uint32_t schema);
+    bool          read(void *buf, size_t len);
+    // start a new record in the oldest slot, the payload's 'length' and 'crc' must be known up front
+    bool          create(uint32_t schema, uint32_t length, uint32_t crc);
+    bool          write(const void *buf, size_t len);
+    void          close(void);
+    // drop every record
+    void          erase(void);
+  private:
+    File          _file;
+
+    bool          mount(void);
+    File          openSlot(uint8_t slot, const char *mode);
+    bool          checkSlot(uint8_t slot, WCStoreHeader *hdr);
+};
+
+#endif
@@ -0,0 +1,27 @@
+#include "wctemplate.h"
+
+size_t wc_split_template(const char *s, const char *slots, WCSegment *segs, size_t max) {
+    size_t n = 0, start = 0;
+
+    if (s == NULL || max == 0)
+        return 0;
+
+    // the last segment is kept back for whatever's left of the template
+    for (size_t i = 0; s[i] != 0 && n + 1 < max; i++) {
+        if (!wc_is_slot(s, i) || strchr(slots, s[i + 1]) == NULL)
+            continue;
+
+        segs[n].offset = start;
+        segs[n].length = i - start;
+        segs[n].slot = s[i + 1];
+        n++;
+
+        i += 2;
+        start = i + 1;
+    }
+
+    segs[n].offset = start;
+    segs[n].length = strlen(s + start);
+    segs[n].slot = 0;
+    return n + 1;
+}
@@ -0,0 +1,66 @@
+/**************************************************************
+   Page templates for WIFIConfig.
+   A template is a string with {x} placeholders; it gets split into a table of
+   literal runs, each followed by the placeholder (slot) it leads up to, so
+   rendering is just a walk over the table without any searching.
+   Library templates are split at compile time by the constexpr helpers below,
+   user templates are split once at runtime by wc_split_template().
+ **************************************************************/
+
+#ifndef WCTemplate_h
+#define WCTemplate_h
+
+#include <Arduino.h>
+
+struct WCSegment {
+    uint16_t offset;    // start of the literal run within the template
+    uint16_t length;    // length of the literal run
+    char     slot;      // placeholder that follows the run, 0 at the end of the template
+};
+
+/* compile-time splitting, C++11 constexpr so every helper is a single expression */
+
+// true if a {x} placeholder starts at s[i]
+constexpr bool wc_is_slot(const char *s, size_t i) {
+    return s[i] == '{' && s[i + 1] != 0 && s[i + 1] != '}' && s[i + 2] == '}';
+}
+
+// position of the first placeholder at or after s[i], or of the terminating nul
+constexpr size_t wc_find_slot(const char *s, size_t i) {
+    return (s[i] == 0 || wc_is_slot(s, i)) ? i : wc_find_slot(s, i + 1);
+}
+
+constexpr size_t wc_seg_end(const char *s, size_t n);
+
+// start of the n-th literal run
+constexpr size_t wc_seg_start(const char *s, size_t n) {
+    return n == 0 ? 0 : wc_seg_end(s, n - 1) + 3;
+}
+
+// end of the n-th literal run, i.e. where its placeholder (or the nul) sits
+constexpr size_t wc_seg_end(const char *s, size_t n) {
+    return wc_find_slot(s, wc_seg_start(s, n));
+}
+
+constexpr char wc_seg_slot(const char *s, size_t n) {
+    return s[wc_seg_end(s, n)] == 0 ? 0 : s[wc_seg_end(s, n) + 1];
+}
+
+// number of segments in a template, i.e. placeholders + 1
+constexpr size_t wc_seg_count(const char *s, size_t n = 0) {
+    return wc_seg_slot(s, n) == 0 ? n + 1 : wc_seg_count(s, n + 1);
+}
+
+#define WC_SEGMENT(t, n)    { (uint16_t)wc_seg_start(t, n), \
+                              (uint16_t)(wc_seg_end(t, n) - wc_seg_start(t, n)), \
+                              wc_seg_slot(t, n) }
+
+#define WC_ARRAY_LEN(a)     (sizeof(a) / sizeof((a)[0]))
+
+/* runtime splitting for templates supplied by the sketch.
+ * Only placeholders listed in 'slots' are recognised, anything else is kept as literal text.
+ * Once 'max' segments are used up, the rest of the template goes out as-is.
+ * Returns the number of segments written. */
+size_t wc_split_template(const char *s, const char *slots, WCSegment *segs, size_t max);
+
+#endif
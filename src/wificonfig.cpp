@@ -13,23 +13,46 @@ Modified by Brian Ejike, 2018.
 **************************************************************/
 
 #include "wificonfig.h"
+#include "wcassets.h"
+#include <new>
+#include <limits.h>
 
-const char WC_HTTP_HEAD[] PROGMEM            = "<!DOCTYPE html><html lang=\"en\"><head><meta name=\"viewport\" content=\"width=device-width, initial-scale=1, user-scalable=no\"/><title>{v}</title>";
-const char WC_HTTP_STYLE[] PROGMEM           = "<style>.c{text-align: center;} div,input{padding:5px;font-size:1em;} input{width:95%;} body{text-align: center;font-family:verdana;} button{border:0;border-radius:0.3rem;background-color:#1fa3ec;color:#fff;line-height:2.4rem;font-size:1.2rem;width:100%;} .q{float: right;width: 64px;text-align: right;} .l{background: url(\"data:image/png;base64,iVBORw0KGgoAAAANSUhEUgAAACAAAAAgCAMAAABEpIrGAAAALVBMVEX///8EBwfBwsLw8PAzNjaCg4NTVVUjJiZDRUUUFxdiZGSho6OSk5Pg4eFydHTCjaf3AAAAZElEQVQ4je2NSw7AIAhEBamKn97/uMXEGBvozkWb9C2Zx4xzWykBhFAeYp9gkLyZE0zIMno9n4g19hmdY39scwqVkOXaxph0ZCXQcqxSpgQpONa59wkRDOL93eAXvimwlbPbwwVAegLS1HGfZAAAAABJRU5ErkJggg==\") no-repeat left center;background-size: 1em;}</style>";
-const char WC_HTTP_SCRIPT[] PROGMEM          = "<script>function c(l){document.getElementById('s').value=l.innerText||l.textContent;document.getElementById('p').focus();}</script>";
+constexpr char WC_HTTP_HEAD[] PROGMEM        = "<!DOCTYPE html><html lang=\"en\"><head><meta name=\"viewport\" content=\"width=device-width, initial-scale=1, user-scalable=no\"/><title>{v}</title>";
+// style and script are served separately, gzipped and versioned by content hash so they can be cached for good
+const char WC_HTTP_ASSETS[] PROGMEM          = "<link rel='stylesheet' href='/s.css?v=" WC_STYLE_HASH "'><script src='/s.js?v=" WC_SCRIPT_HASH "'></script>";
 const char WC_HTTP_HEAD_END[] PROGMEM        = "</head><body><div style='text-align:left;display:inline-block;min-width:260px;'>";
-const char WC_HTTP_ITEM[] PROGMEM            = "<div><a href='#p' onclick='c(this)'>{v}</a>&nbsp;<span class='q {i}'>{r}%</span></div>";
-const char WC_HTTP_FORM_START[] PROGMEM      = "<form method='get' action='wifisave'><input id='s' name='s' length=32 placeholder='SSID'><br/><input id='p' name='p' length=64 type='password' placeholder='Passkey'><br/>";
-const char WC_HTTP_FORM_PARAM[] PROGMEM      = "<br/><input id='{i}' name='{n}' maxlength={l} placeholder='{p}' value='{v}' {c}>";
+constexpr char WC_HTTP_ITEM[] PROGMEM        = "<div><a href='#p' onclick='c(this)'>{v}</a>&nbsp;<span class='q {i}'>{r}%</span></div>";
+const char WC_HTTP_FORM_START[] PROGMEM      = "<form method='post' action='wifisave' onsubmit='return w(this)'><input id='s' name='s' length=32 placeholder='SSID'><br/><input id='p' name='p' length=64 type='password' placeholder='Passkey'><br/>";
+constexpr char WC_HTTP_FORM_PARAM[] PROGMEM  = "<br/><input id='{i}' name='{n}' maxlength={l} placeholder='{p}' value='{v}' {c}>";
 const char WC_HTTP_FORM_END[] PROGMEM        = "<br/><button type='submit'>Configure</button></form>";
-const char WC_HTTP_SAVED[] PROGMEM           = "<div>Configuration successful.<br /></div>";
+const char WC_HTTP_SAVED[] PROGMEM           = "<div>Configuration successful.<br /></div><div id='st'></div>";
 const char WC_HTTP_END[] PROGMEM             = "</div></body></html>";
 
+/* templates with placeholders, pre-split at compile time */
+constexpr WCSegment WC_HEAD_SEGS[] PROGMEM = {
+    WC_SEGMENT(WC_HTTP_HEAD, 0), WC_SEGMENT(WC_HTTP_HEAD, 1)
+};
+static_assert(WC_ARRAY_LEN(WC_HEAD_SEGS) == wc_seg_count(WC_HTTP_HEAD), "WC_HEAD_SEGS doesn't match WC_HTTP_HEAD");
+
+constexpr WCSegment WC_FORM_PARAM_SEGS[] PROGMEM = {
+    WC_SEGMENT(WC_HTTP_FORM_PARAM, 0), WC_SEGMENT(WC_HTTP_FORM_PARAM, 1), WC_SEGMENT(WC_HTTP_FORM_PARAM, 2),
+    WC_SEGMENT(WC_HTTP_FORM_PARAM, 3), WC_SEGMENT(WC_HTTP_FORM_PARAM, 4), WC_SEGMENT(WC_HTTP_FORM_PARAM, 5),
+    WC_SEGMENT(WC_HTTP_FORM_PARAM, 6)
+};
+static_assert(WC_ARRAY_LEN(WC_FORM_PARAM_SEGS) == wc_seg_count(WC_HTTP_FORM_PARAM), "WC_FORM_PARAM_SEGS doesn't match WC_HTTP_FORM_PARAM");
+
+constexpr WCSegment WC_ITEM_SEGS[] PROGMEM = {
+    WC_SEGMENT(WC_HTTP_ITEM, 0), WC_SEGMENT(WC_HTTP_ITEM, 1), WC_SEGMENT(WC_HTTP_ITEM, 2),
+    WC_SEGMENT(WC_HTTP_ITEM, 3)
+};
+static_assert(WC_ARRAY_LEN(WC_ITEM_SEGS) == wc_seg_count(WC_HTTP_ITEM), "WC_ITEM_SEGS doesn't match WC_HTTP_ITEM");
+
 WIFIConfigParam::WIFIConfigParam(const char *custom) {
     _id = NULL;
     _placeholder = NULL;
     _length = 0;
     _value = NULL;
+    _stageOffset = 0;
 
     _customHTML = custom;
 }
@@ -66,82 +89,224 @@ const char* WIFIConfigParam::getCustomHTML() {
     return _customHTML;
 }
 
-WIFIConfig::WIFIConfig(const char * page_title) : 
-server(80), _page_title(page_title)
+WIFIConfigBase::WIFIConfigBase(const char * page_title, WIFIConfigParam **params, uint8_t *index,
+                               uint16_t maxParams, uint16_t indexSize, char *arena, size_t arenaSize) :
+_params(params), _maxParams(maxParams), _paramIndex(index), _paramIndexSize(indexSize),
+_arena(arena), _arenaSize(arenaSize), _page_title(page_title)
 {
-    
+    memset(_paramIndex, WC_NO_PARAM, _paramIndexSize);
+    memset(_slotState, WC_SLOT_FREE, sizeof(_slotState));
+    memset(_clients, 0, sizeof(_clients));
+    memset(&_connectStats, 0, sizeof(_connectStats));
+    strcpy(_portalURL, "/");
+    _ssid[0] = 0;
+    _pass[0] = 0;
+}
+
+static uint32_t fnv1a(uint32_t h, const void *data, size_t len) {
+    const uint8_t *p = (const uint8_t *)data;
+    while (len--) {
+        h ^= *p++;
+        h *= 16777619UL;
+    }
+    return h;
+}
+
+static uint32_t hashID(const char *id, size_t len) {
+    return fnv1a(2166136261UL, id, len);
+}
+
+// add parameter 'i' to the ID lookup table, the first of any duplicate IDs wins
+void WIFIConfigBase::indexParam(uint8_t i) {
+    const char *id = _params[i]->getID();
+    if (id == NULL)
+        return;
+
+    size_t len = strlen(id);
+    uint16_t mask = _paramIndexSize - 1;
+    for (uint16_t slot = hashID(id, len) & mask; ; slot = (slot + 1) & mask) {
+        if (_paramIndex[slot] == WC_NO_PARAM) {
+            _paramIndex[slot] = i;
+            return;
+        }
+        if (strcmp(_params[_paramIndex[slot]]->getID(), id) == 0)
+            return;
+    }
+}
+
+// index of the parameter with the given ID, which needn't be nul-terminated. -1 if there's none
+int WIFIConfigBase::findParam(const char *id, size_t len) {
+    uint16_t mask = _paramIndexSize - 1;
+    // the table's never more than half full, so this always hits an empty slot eventually
+    for (uint16_t slot = hashID(id, len) & mask; _paramIndex[slot] != WC_NO_PARAM; slot = (slot + 1) & mask) {
+        const char *pid = _params[_paramIndex[slot]]->getID();
+        if (strncmp(pid, id, len) == 0 && pid[len] == 0)
+            return _paramIndex[slot];
+    }
+    return -1;
 }
 
-void WIFIConfig::addParameter(WIFIConfigParam *p, char *buffer, int length, bool hasDefault) {
-    if(_paramsCount + 1 > WIFICONFIG_MAX_PARAMS)
+void WIFIConfigBase::addParameter(WIFIConfigParam *p, char *buffer, int length, bool hasDefault) {
+    if(_paramsCount + 1 > _maxParams)
     {
         //Max parameters exceeded!
-        WC_DEBUG_PRINTLN("WIFICONFIG_MAX_PARAMS exceeded, increase number (in WIFIConfig.h) before adding more parameters!");
-        WC_DEBUG_PRINTLN("Skipping parameter with ID:");
-        WC_DEBUG_PRINTLN(p->getID());
+        WC_LOGW(PARAMS_FULL, p->getID(), 0);
         return;
     }
 
     p->_value = buffer;
     p->_length = length;
+    p->_stageOffset = 0;
 
     // nul terminate the parameter buffer, if there's no default value
     if (!hasDefault && p->_value != NULL && p->_length != 0)
     p->_value[0] = 0;
 
     _params[_paramsCount] = p;
+    indexParam(_paramsCount);
     _paramsCount++;
-    WC_DEBUG_PRINT("::Adding parameter: ");
-    WC_DEBUG_PRINTLN(p->getID());
+    _pageGeneration++;
+    WC_LOGD(PARAM_ADDED, p->getID(), 0);
+}
+
+void WIFIConfigBase::addParameter(WIFIConfigParam *p, int length, const char *defaultValue) {
+    if (length < 0 || _arenaUsed + length + 1 > _arenaSize) {
+        WC_LOGW(ARENA_FULL, p->getID(), 0);
+        return;
+    }
+
+    char *buffer = _arena + _arenaUsed;
+    buffer[0] = 0;
+    if (defaultValue != NULL) {
+        strncpy(buffer, defaultValue, length);
+        buffer[length] = 0;
+    }
+
+    // the space is only claimed if the parameter actually made it onto the list
+    int count = _paramsCount;
+    addParameter(p, buffer, length, true);
+    if (_paramsCount != count)
+        _arenaUsed += length + 1;
 }
 
-void WIFIConfig::resetParameterList(void) {
+void WIFIConfigBase::resetParameterList(void) {
     _paramsCount = 0;
+    _arenaUsed = 0;
+    memset(_paramIndex, WC_NO_PARAM, _paramIndexSize);
+    _pageGeneration++;
 }
 
-void WIFIConfig::setupConfigPortal() {
-    dnsServer.reset(new DNSServer());
+void WIFIConfigBase::setupConfigPortal() {
+    if (_dns == NULL)
+        _dns = new (_dnsStorage) WIFIConfigDNS();
 
     _configPortalStart = millis();
 
-    WC_DEBUG_PRINT("::Configuring access point: ");
-    WC_DEBUG_PRINTLN(_apName);
-
     if (_apPassword != NULL) {
         WiFi.softAP(_apName, _apPassword);//password option
     } else {
         WiFi.softAP(_apName);
     }
 
-    delay(500); // Without delay I've seen the IP address blank
-    WC_DEBUG_PRINT("::AP IP address: ");
-    WC_DEBUG_PRINTLN(WiFi.softAPIP());
+    // DNS goes up from config_loop once the AP has had time to settle
+    _portalState = WC_PORTAL_AP_STARTING;
+    _portalDeadline = millis() + WC_AP_SETTLE_MS;
 
-    /* Setup the DNS server redirecting all the domains to the apIP */
-    dnsServer->setErrorReplyCode(DNSReplyCode::NoError);
-    dnsServer->start(DNS_PORT, "*", WiFi.softAPIP());
+    /* Web server, with every route behind the one dispatcher. The last portal's is gone by now,
+     * startConfigPortal saw to that */
+    if (_server == NULL) {
+        _server = new (_serverStorage) WIFIConfigServer(this);
+        // both owned by the server from here on, and deleted along with it.
+        // The dispatcher takes anything it's offered, so it has to come last
+        _events = new AsyncEventSource("/events");
+        _events->onConnect([this](AsyncEventSourceClient *client) { eventsConnected(client); });
+        _server->addHandler(_events);
+        _server->addHandler(newDispatcher());
+    }
+    _server->begin(); // Web server start
+    WC_LOGD(SERVER_STARTED, 0, 0);
+}
 
-    /* Setup web pages: root, wifi config pages, SO captive portal detectors and not found. */
-    server.on("/", std::bind(&WIFIConfig::handleRoot, this, std::placeholders::_1));
-    server.on("/wifisave", std::bind(&WIFIConfig::handleWifiSave, this, std::placeholders::_1));
-    server.on("/i", std::bind(&WIFIConfig::handleInfo, this, std::placeholders::_1));
-    server.on("/r", std::bind(&WIFIConfig::handleReset, this, std::placeholders::_1));
-    server.on("/fwlink", std::bind(&WIFIConfig::handleRoot, this, std::placeholders::_1));  //Microsoft captive portal. Maybe not needed. Might be handled by notFound handler.
-    server.onNotFound (std::bind(&WIFIConfig::handleRoot, this, std::placeholders::_1));
-    server.begin(); // Web server start
-    WC_DEBUG_PRINTLN("::HTTP server started");
+// true once 'deadline' (a millis() value) has passed, safe across millis() wraparound
+static bool deadlineReached(unsigned long deadline) {
+    return (long)(millis() - deadline) >= 0;
+}
+
+void WIFIConfigBase::startDNS() {
+    /* Setup the DNS server redirecting all the domains to the apIP */
+    IPAddress ip = WiFi.softAPIP();
+    _dns->start(DNS_PORT, ip);
 
+    // probes get sent here from now on
+    snprintf(_portalURL, sizeof(_portalURL), "http://%u.%u.%u.%u/", ip[0], ip[1], ip[2], ip[3]);
+    WC_LOGI(AP_ADDRESS, (uint32_t)ip, 0);
 }
 
-boolean WIFIConfig::configPortalHasTimeout() {
-    if(_configPortalTimeout == 0 || WiFi.softAPgetStationNum() > 0) {
-        _configPortalStart = millis(); // kludge, bump configportal start time to skew timeouts
+boolean WIFIConfigBase::configPortalHasTimeout() {
+    // no timing out on anyone using the portal, the clock restarts when the last station leaves
+    if (_configPortalTimeout == 0 || _stations > 0)
         return false;
+    return deadlineReached(_configPortalStart + _configPortalTimeout);
+}
+
+/** Station tracking, from WiFi events */
+#if defined(ARDUINO_ARCH_ESP32)
+    #if defined(ESP_ARDUINO_VERSION_MAJOR) && ESP_ARDUINO_VERSION_MAJOR >= 2
+        #define WC_AP_STA_JOINED    ARDUINO_EVENT_WIFI_AP_STACONNECTED
+        #define WC_AP_STA_LEFT      ARDUINO_EVENT_WIFI_AP_STADISCONNECTED
+    #else
+        #define WC_AP_STA_JOINED    SYSTEM_EVENT_AP_STACONNECTED
+        #define WC_AP_STA_LEFT      SYSTEM_EVENT_AP_STADISCONNECTED
+    #endif
+#endif
+
+void WIFIConfigBase::watchStations(bool enable) {
+#if defined(ARDUINO_ARCH_ESP8266)
+    if (enable) {
+        _stationJoinedHandler = WiFi.onSoftAPModeStationConnected([this](const WiFiEventSoftAPModeStationConnected &) {
+            stationJoined();
+        });
+        _stationLeftHandler = WiFi.onSoftAPModeStationDisconnected([this](const WiFiEventSoftAPModeStationDisconnected &) {
+            stationLeft();
+        });
+    }
+    else {
+        // dropping the handles unregisters them
+        _stationJoinedHandler = nullptr;
+        _stationLeftHandler = nullptr;
+    }
+#elif defined(ARDUINO_ARCH_ESP32)
+    if (enable && _stationEvents == 0) {
+        _stationEvents = WiFi.onEvent([this](WiFiEvent_t event, WiFiEventInfo_t) {
+            if (event == WC_AP_STA_JOINED)
+                stationJoined();
+            else if (event == WC_AP_STA_LEFT)
+                stationLeft();
+        });
     }
-    return (millis() > _configPortalStart + _configPortalTimeout);
+    else if (!enable && _stationEvents != 0) {
+        WiFi.removeEvent(_stationEvents);
+        _stationEvents = 0;
+    }
+#endif
+    _stations = 0;
+}
+
+// these two come from the WiFi event context
+void WIFIConfigBase::stationJoined(void) {
+    __atomic_add_fetch(&_stations, 1, __ATOMIC_RELEASE);
 }
 
-boolean WIFIConfig::startConfigPortal() {
+void WIFIConfigBase::stationLeft(void) {
+    // restart the clock before the count can reach 0, so the timeout never sees a stale start
+    _configPortalStart = millis();
+    uint8_t n = __atomic_load_n(&_stations, __ATOMIC_RELAXED);
+    // it may have joined before the handlers went in
+    while (n > 0 && !__atomic_compare_exchange_n(&_stations, &n, n - 1, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        ;
+}
+
+boolean WIFIConfigBase::startConfigPortal() {
 #if defined(ARDUINO_ARCH_ESP8266)
     String ssid = "ESP" + String(ESP.getChipId());
 #elif defined(ARDUINO_ARCH_ESP32)
@@ -152,243 +317,2164 @@ boolean WIFIConfig::startConfigPortal() {
     return startConfigPortal(ssid.c_str(), NULL);
 }
 
-boolean WIFIConfig::startConfigPortal(char const *apName, char const *apPassword) {
-    //setup AP
-    WiFi.mode(WIFI_AP);
-    WC_DEBUG_PRINTLN("::Setting up AP");
+boolean WIFIConfigBase::startConfigPortal(char const *apName, char const *apPassword) {
+#if defined(ARDUINO_ARCH_ESP32)
+    // the last portal's task is still winding down
+    if (_task != NULL)
+        return false;
+#endif
+    // the last portal's clients are still around, and may still be writing to its staging records
+    if (!releaseServer())
+        return false;
+    //setup AP, the station side is only needed for scanning
+    WiFi.mode(_scanInterval != 0 ? WIFI_AP_STA : WIFI_AP);
+    WC_LOGI(AP_START, _configPortalTimeout, 0);
 
     _apName = apName;
     _apPassword = apPassword;
 
-    recvd_config = false;
+    // first scan goes out right away
+    _scanning = false;
+    _lastScan = millis() - _scanInterval;
+
+    if (!allocStage())
+        return false;
+
+    _restartRequested = false;
     config_state = WIFICONFIG_INPROGRESS;
+    _status = WC_STATUS_NONE;
+    _eventsPending = 0;
+    memset(_clients, 0, sizeof(_clients));
+    strcpy(_portalURL, "/");
+    _dnsBacklog = false;
+    // before the AP goes up, so no station is missed
+    watchStations(true);
+#if defined(WC_ENABLE_STATS)
+    resetStats();
+#endif
     setupConfigPortal();
 
+#if defined(ARDUINO_ARCH_ESP32)
+    if (_useTask) {
+        _taskDone = false;
+        if (xTaskCreatePinnedToCore(portalTask, "wcportal", WC_TASK_STACK, this, WC_TASK_PRIORITY,
+                                    &_task, WC_TASK_CORE) != pdPASS) {
+            // config_loop will have to drive it then
+            _task = NULL;
+        }
+    }
+#endif
+
     return true;
 }
 
-uint8_t WIFIConfig::config_loop(void) {
-    if (config_state == WIFICONFIG_COMPLETE || 
-            config_state == WIFICONFIG_TIMEOUT ||
-            config_state == WIFICONFIG_NOTSTARTED)
-    return config_state;
-    
-    if (configPortalHasTimeout()) {
-        config_state = WIFICONFIG_TIMEOUT;
-        WC_DEBUG_PRINTLN("::Timeout. Stopping servers");
-        cleanup();
-    }
-    
-    else if (recvd_config) {
-        recvd_config = false;
-        delay(1000);
-        WC_DEBUG_PRINTLN("::Done. Stopping servers");
-        
-        cleanup();
-        config_state = WIFICONFIG_COMPLETE;
-        
+uint8_t WIFIConfigBase::config_loop(void) {
+    wc_log_drain();
+
+#if defined(ARDUINO_ARCH_ESP32)
+    if (_task != NULL) {
+        // the task owns the portal until it says it's done
+        if (!__atomic_load_n(&_taskDone, __ATOMIC_ACQUIRE))
+            return WIFICONFIG_INPROGRESS;
+        _task = NULL;
+    }
+    else
+#endif
+    portalStep();
+
+    if (_callbackPending) {
+        _callbackPending = false;
         if ( _savecallback != NULL) {
             _savecallback();
         }
     }
-    else {
-        dnsServer->processNextRequest();
-    }
-    
     return config_state;
 }
 
+uint8_t WIFIConfigBase::config_loop(unsigned long *idleMs) {
+    uint8_t state = config_loop();
+#if defined(ARDUINO_ARCH_ESP32)
+    // the task keeps its own time, there's only its finishing to look out for
+    if (_task != NULL) {
+        *idleMs = WC_IDLE_POLL_MS;
+        return state;
+    }
+#endif
+    *idleMs = portalIdle();
+    return state;
+}
+
+// ms until 'deadline', 0 if it's passed, and no more than 'cap'
+static unsigned long untilDeadline(unsigned long deadline, unsigned long cap = ULONG_MAX) {
+    long left = (long)(deadline - millis());
+    if (left <= 0)
+        return 0;
+    return (unsigned long)left < cap ? left : cap;
+}
+
+unsigned long WIFIConfigBase::portalIdle(void) {
+    unsigned long idle = WC_IDLE_POLL_MS;
+
+    switch (_portalState) {
+        case WC_PORTAL_IDLE:
+            // only a kept server left to see to
+            return _server != NULL ? WC_TEARDOWN_MS : ULONG_MAX;
+
+        case WC_PORTAL_AP_STARTING:
+        case WC_PORTAL_RESTARTING:
+            // nothing else going on
+            return untilDeadline(_portalDeadline);
+
+        case WC_PORTAL_TEARDOWN:
+            if (__atomic_load_n(&_requestsLive, __ATOMIC_ACQUIRE) == 0)
+                return 0;
+            idle = untilDeadline(_portalDeadline, idle);
+            break;
+
+        case WC_PORTAL_RUNNING:
+        case WC_PORTAL_DRAINING:
+        case WC_PORTAL_VERIFYING:
+            if (_dnsBacklog || _restartRequested)
+                return 0;
+            for (int i = 0; i < WC_STAGE_SLOTS; i++) {
+                // a submitted config waiting to be committed
+                if (__atomic_load_n(&_slotState[i], __ATOMIC_ACQUIRE) >= WC_SLOT_READY)
+                    return 0;
+            }
+            if (_portalState != WC_PORTAL_RUNNING) {
+                // the station's progress isn't signalled either, it's polled at WC_IDLE_POLL_MS
+                idle = untilDeadline(_portalDeadline, idle);
+                break;
+            }
+            if (_configPortalTimeout != 0 && _stations == 0)
+                idle = untilDeadline(_configPortalStart + _configPortalTimeout, idle);
+            if (_scanInterval != 0 && !_scanning)
+                idle = untilDeadline(_lastScan + _scanInterval, idle);
+            break;
+
+        default:
+            return 0;
+    }
+
+    if (_eventsPending != 0 && _events != NULL && _events->count() != 0)
+        idle = untilDeadline(_lastPush + WC_EVENT_INTERVAL_MS, idle);
+    return idle;
+}
+
+/* Nothing in here ever waits: each state either does its bit of work and returns,
+ * or checks its deadline and returns, so it can be spun as fast as anyone likes */
+void WIFIConfigBase::portalStep(void) {
+    switch (_portalState) {
+        case WC_PORTAL_AP_STARTING:
+            if (!deadlineReached(_portalDeadline))
+                break;
+            // without this I've seen the IP address blank
+            if ((uint32_t)WiFi.softAPIP() == 0) {
+                _portalDeadline = millis() + WC_AP_RETRY_MS;
+                break;
+            }
+            startDNS();
+            _portalState = WC_PORTAL_RUNNING;
+            break;
+
+        case WC_PORTAL_RUNNING:
+            if (_restartRequested) {
+                // give the reset page time to get out
+                WC_LOGI(RESTARTING, 0, 0);
+                _portalState = WC_PORTAL_RESTARTING;
+                _portalDeadline = millis() + WC_RESTART_DRAIN_MS;
+            }
+            else if (configPortalHasTimeout()) {
+                WC_LOGI(TIMEOUT, 0, 0);
+                beginTeardown(WIFICONFIG_TIMEOUT);
+            }
+            else if (commitRecord()) {
+                if (_connectCheck != 0) {
+                    beginVerify();
+                    break;
+                }
+                setStatus(WC_STATUS_SAVED);
+                // keep serving until the saved page has gone out
+                _portalState = WC_PORTAL_DRAINING;
+                _portalDeadline = millis() + WC_SAVE_DRAIN_MS;
+            }
+            else {
+                serviceDNS();
+                updateScan();
+                flushEvents();
+                WC_STATS_SAMPLE();
+            }
+            break;
+
+        case WC_PORTAL_DRAINING:
+            if (!deadlineReached(_portalDeadline)) {
+                // a later submission still wins, and gets checked like the first
+                if (commitRecord() && _connectCheck != 0) {
+                    beginVerify();
+                    break;
+                }
+                serviceDNS();
+                flushEvents();
+                break;
+            }
+            WC_LOGI(DONE, 0, 0);
+            beginTeardown(WIFICONFIG_COMPLETE);
+            break;
+
+        case WC_PORTAL_VERIFYING: {
+            // a reset doesn't wait on the check
+            if (_restartRequested) {
+                _portalState = WC_PORTAL_RUNNING;
+                break;
+            }
+            // a later submission starts the check over
+            if (commitRecord()) {
+                beginVerify();
+                break;
+            }
+            wl_status_t status = WiFi.status();
+            if (status == WL_CONNECTED) {
+                WC_LOGI(CONNECTED, millis() - (_portalDeadline - _connectCheck), 0);
+                setStatus(WC_STATUS_CONNECTED);
+                // then the same as without the check
+                _portalState = WC_PORTAL_DRAINING;
+                _portalDeadline = millis() + WC_SAVE_DRAIN_MS;
+                break;
+            }
+            if (status == WL_CONNECT_FAILED || deadlineReached(_portalDeadline)) {
+                WC_LOGW(CONNECT_FAILED, millis() - (_portalDeadline - _connectCheck), 0);
+                setStatus(WC_STATUS_CONNECT_FAILED);
+                WiFi.disconnect(false);
+                // back to waiting for another go, the portal timeout included
+                _portalState = WC_PORTAL_RUNNING;
+                break;
+            }
+            serviceDNS();
+            flushEvents();
+            break;
+        }
+
+        case WC_PORTAL_TEARDOWN:
+            flushEvents();
+            // the pages have been told, their event streams are all that's left holding them open
+            if (_eventsPending == 0 && _events->count() != 0 && _events->avgPacketsWaiting() == 0)
+                _events->close();
+            if (__atomic_load_n(&_requestsLive, __ATOMIC_ACQUIRE) != 0 && !deadlineReached(_portalDeadline))
+                break;
+            cleanup();
+            _portalState = WC_PORTAL_IDLE;
+            config_state = _portalResult;
+            if (config_state != WIFICONFIG_COMPLETE)
+                break;
+#if defined(WC_ENABLE_STORE)
+            if (!saveConfig())
+                WC_LOGE(SAVE_FAILED, 0, 0);
+#endif
+#if defined(WC_ENABLE_STATS)
+            _stats.completeMs = millis() - _statsStart;
+#endif
+            _callbackPending = true;
+            break;
+
+        case WC_PORTAL_RESTARTING:
+            if (deadlineReached(_portalDeadline))
+                ESP.restart();
+            break;
+
+        case WC_PORTAL_IDLE:
+            // a server kept by cleanup() goes once its last connection has
+            releaseServer();
+            break;
+
+        default:
+            break;
+    }
+}
+
+void WIFIConfigBase::serviceDNS(void) {
+    uint16_t handled = _dns->processRequests();
+    WC_STATS_DNS(handled);
+    _dnsBacklog = handled >= WC_DNS_BUDGET;
+}
+
+#if defined(ARDUINO_ARCH_ESP32)
+void WIFIConfigBase::setPortalTask(bool enable) {
+    _useTask = enable;
+}
+
+void WIFIConfigBase::portalTask(void *arg) {
+    WIFIConfigBase *wc = (WIFIConfigBase *)arg;
+    do {
+        wc->portalStep();
+        vTaskDelay(pdMS_TO_TICKS(WC_TASK_PERIOD_MS));
+    } while (wc->_portalState != WC_PORTAL_IDLE);
+
+    // everything the task did is visible to config_loop once it sees this
+    __atomic_store_n(&wc->_taskDone, true, __ATOMIC_RELEASE);
+    vTaskDelete(NULL);
+}
+#endif
+
+// start the station on the config just committed, with the AP left up for the page to hear how it goes
+void WIFIConfigBase::beginVerify(void) {
+    // the station can't join a network and scan at once
+    if (_scanning) {
+        WiFi.scanDelete();
+        _scanning = false;
+    }
+    _lastScan = millis();
+    setStatus(WC_STATUS_CONNECTING);
+    WiFi.mode(WIFI_AP_STA);
+    WiFi.begin(_ssid, _pass);
+    _portalState = WC_PORTAL_VERIFYING;
+    _portalDeadline = millis() + _connectCheck;
+}
+
+// stop taking connections, then let config_loop wait out the requests in progress
+void WIFIConfigBase::beginTeardown(uint8_t result) {
+    // tell the pages now, ahead of the interval, so it's out before the connections close
+    setStatus(WC_STATUS_CLOSING);
+    _lastPush = millis() - WC_EVENT_INTERVAL_MS;
+    flushEvents();
+    _server->end();
+    _portalResult = result;
+    _portalState = WC_PORTAL_TEARDOWN;
+    _portalDeadline = millis() + WC_TEARDOWN_MS;
+}
+
 // 'len' stands for the max number of chars to copy excluding the nul byte 
-bool WIFIConfig::get_wifi_ssid(char * ssidbuf, uint16_t len) {
-    if (_ssid == "" || _ssid.length() > len)
+bool WIFIConfigBase::get_wifi_ssid(char * ssidbuf, uint16_t len) {
+    if (_ssid[0] == 0 || strlen(_ssid) > len)
     return false;
-    _ssid.toCharArray(ssidbuf, len + 1);
+    strcpy(ssidbuf, _ssid);
     return true;
 }
 
 // 'len' stands for the max number of chars to copy excluding the nul byte 
-bool WIFIConfig::get_wifi_passkey(char * keybuf, uint16_t len) {
-    if (_pass.length() > len)
+bool WIFIConfigBase::get_wifi_passkey(char * keybuf, uint16_t len) {
+    if (strlen(_pass) > len)
+        return false;
+    strcpy(keybuf, _pass);
+    return true;
+}
+
+#if defined(WC_ENABLE_STORE)
+/** Saved config: the SSID and passkey buffers, then the buffer of each parameter that has one,
+ * in the order they were added, each at full size with its nul */
+WIFIConfigParam* WIFIConfigBase::storedParam(int i) {
+    WIFIConfigParam *p = _params[i];
+    return p != NULL && p->_value != NULL && p->_length > 0 ? p : NULL;
+}
+
+uint32_t WIFIConfigBase::storeSchema(void) {
+    uint32_t h = 2166136261UL;
+    const uint16_t sizes[] = { WC_SSID_MAX_LEN, WC_PASS_MAX_LEN };
+    h = fnv1a(h, sizes, sizeof(sizes));
+    for (int i = 0; i < _paramsCount; i++) {
+        WIFIConfigParam *p = storedParam(i);
+        if (p == NULL)
+            continue;
+        h = fnv1a(h, p->getID(), p->getID() != NULL ? strlen(p->getID()) + 1 : 0);
+        h = fnv1a(h, &p->_length, sizeof(p->_length));
+    }
+    return h;
+}
+
+uint32_t WIFIConfigBase::storeCRC(uint32_t *length) {
+    uint32_t crc = wc_crc32(_ssid, sizeof(_ssid));
+    crc = wc_crc32(_pass, sizeof(_pass), crc);
+    *length = sizeof(_ssid) + sizeof(_pass);
+    for (int i = 0; i < _paramsCount; i++) {
+        WIFIConfigParam *p = storedParam(i);
+        if (p == NULL)
+            continue;
+        crc = wc_crc32(p->_value, p->_length + 1, crc);
+        *length += p->_length + 1;
+    }
+    return crc;
+}
+
+bool WIFIConfigBase::loadConfig(void) {
+    // the payload's been checked already, so it's read straight into place
+    if (!_store.openLatest(storeSchema()))
+        return false;
+    bool ok = _store.read(_ssid, sizeof(_ssid)) && _store.read(_pass, sizeof(_pass));
+    for (int i = 0; ok && i < _paramsCount; i++) {
+        WIFIConfigParam *p = storedParam(i);
+        if (p == NULL)
+            continue;
+        ok = _store.read(p->_value, p->_length + 1);
+        p->_value[p->_length] = 0;
+    }
+    _store.close();
+    _ssid[WC_SSID_MAX_LEN] = 0;
+    _pass[WC_PASS_MAX_LEN] = 0;
+    if (!ok) {
+        _ssid[0] = 0;
+        _pass[0] = 0;
+    }
+    return ok && _ssid[0] != 0;
+}
+
+bool WIFIConfigBase::saveConfig(void) {
+    uint32_t length;
+    uint32_t crc = storeCRC(&length);
+    bool ok = _store.create(storeSchema(), length, crc) && _store.write(_ssid, sizeof(_ssid))
+              && _store.write(_pass, sizeof(_pass));
+    for (int i = 0; ok && i < _paramsCount; i++) {
+        WIFIConfigParam *p = storedParam(i);
+        if (p == NULL)
+            continue;
+        ok = _store.write(p->_value, p->_length + 1);
+    }
+    _store.close();
+    return ok;
+}
+
+void WIFIConfigBase::eraseConfig(void) {
+    _store.erase();
+}
+
+boolean WIFIConfigBase::autoConfigPortal(char const *apName, char const *apPassword) {
+    if (loadConfig()) {
+        WC_LOGI(CONFIG_LOADED, 0, 0);
+        config_state = WIFICONFIG_COMPLETE;
+        return true;
+    }
+    return startConfigPortal(apName, apPassword);
+}
+#endif
+
+/** Station connects */
+static uint32_t credHash(const char *ssid, const char *pass) {
+    uint32_t h = hashID(ssid, strlen(ssid) + 1);
+    if (pass != NULL) {
+        while (*pass) {
+            h ^= (uint8_t)*pass++;
+            h *= 16777619UL;
+        }
+    }
+    return h;
+}
+
+// wait for the station to connect, or for 'deadline'. A fast connect also gives up
+// as soon as the remembered AP turns out not to be there
+bool WIFIConfigBase::waitConnected(unsigned long deadline, bool fast) {
+    for (;;) {
+        wl_status_t status = WiFi.status();
+        if (status == WL_CONNECTED)
+            return true;
+        if (status == WL_CONNECT_FAILED || (fast && status == WL_NO_SSID_AVAIL) || deadlineReached(deadline))
+            return false;
+        delay(10);
+    }
+}
+
+void WIFIConfigBase::recordConnect(unsigned long start, bool fast, bool ok) {
+    uint32_t ms = millis() - start;
+    _connectStats.lastMs = ms;
+    _connectStats.lastFast = fast && ok;
+    if (!ok)
+        return;
+    if (fast) {
+        _connectStats.fastConnects++;
+        _connectStats.fastTotalMs += ms;
+    } else {
+        _connectStats.fullConnects++;
+        _connectStats.fullTotalMs += ms;
+    }
+}
+
+bool WIFIConfigBase::connect(const char *ssid, const char *pass, unsigned long timeout, bool keepLease) {
+    unsigned long start = millis();
+    WiFi.mode(WIFI_STA);
+    WiFi.begin(ssid, pass);
+    bool ok = waitConnected(start + timeout, false);
+    recordConnect(start, false, ok);
+    if (!ok) {
+        WC_LOGW(CONNECT_FAILED, _connectStats.lastMs, 0);
         return false;
-    _pass.toCharArray(keybuf, len + 1);
+    }
+
+    // only written if something's changed
+    WCFastRecord rec, old;
+    memset(&rec, 0, sizeof(rec));
+    rec.credHash = credHash(ssid, pass);
+    memcpy(rec.bssid, WiFi.BSSID(), sizeof(rec.bssid));
+    rec.channel = WiFi.channel();
+    if (keepLease) {
+        rec.hasLease = 1;
+        rec.ip = WiFi.localIP();
+        rec.gateway = WiFi.gatewayIP();
+        rec.subnet = WiFi.subnetMask();
+        rec.dns = WiFi.dnsIP();
+    }
+    if (!wc_fast_load(&old) || memcmp(&old.credHash, &rec.credHash, sizeof(rec) - offsetof(WCFastRecord, credHash)) != 0)
+        wc_fast_save(&rec);
+
+    WC_LOGI(CONNECTED, _connectStats.lastMs, 0);
     return true;
 }
 
-String WIFIConfig::getConfigPortalSSID() {
+bool WIFIConfigBase::fastConnect(const char *ssid, const char *pass, unsigned long timeout, bool keepLease) {
+    unsigned long start = millis();
+    WCFastRecord rec;
+    if (!wc_fast_load(&rec) || rec.credHash != credHash(ssid, pass))
+        return connect(ssid, pass, timeout, keepLease);
+
+    WiFi.mode(WIFI_STA);
+    if (rec.hasLease)
+        WiFi.config(IPAddress(rec.ip), IPAddress(rec.gateway), IPAddress(rec.subnet), IPAddress(rec.dns));
+    WiFi.begin(ssid, pass, rec.channel, rec.bssid);
+
+    unsigned long budget = timeout < WC_FAST_CONNECT_MS ? timeout : WC_FAST_CONNECT_MS;
+    if (waitConnected(start + budget, true)) {
+        recordConnect(start, true, true);
+        WC_LOGI(FAST_CONNECTED, _connectStats.lastMs, 0);
+        return true;
+    }
+
+    // the AP's moved, or gone. Start over from scratch, with DHCP
+    WC_LOGW(FAST_STALE, 0, 0);
+    _connectStats.fastFallbacks++;
+    wc_fast_clear();
+    WiFi.disconnect();
+    if (rec.hasLease)
+        WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));
+
+    unsigned long spent = millis() - start;
+    bool ok = spent < timeout && connect(ssid, pass, timeout - spent, keepLease);
+    // count the whole thing, failed fast attempt included
+    _connectStats.lastMs = millis() - start;
+    return ok;
+}
+
+void WIFIConfigBase::forgetFastConnect(void) {
+    wc_fast_clear();
+}
+
+const WIFIConfigConnectStats& WIFIConfigBase::getConnectStats(void) {
+    return _connectStats;
+}
+
+String WIFIConfigBase::getConfigPortalSSID() {
     return _apName;
 }
 
-void WIFIConfig::resetSettings() {
-    WC_DEBUG_PRINTLN("::settings invalidated");
-    WC_DEBUG_PRINTLN("::THIS MAY CAUSE AP NOT TO START UP PROPERLY. YOU NEED TO COMMENT IT OUT AFTER ERASING THE DATA.");
+void WIFIConfigBase::resetSettings() {
+    WC_LOGW(SETTINGS_RESET, 0, 0);
     WiFi.disconnect(true);
     //delay(200);
 }
 
-void WIFIConfig::setConfigPortalTimeout(unsigned long seconds) {
+void WIFIConfigBase::setConfigPortalTimeout(unsigned long seconds) {
     _configPortalTimeout = seconds * 1000UL;
 }
 
-/** Wifi config page handler */
-void WIFIConfig::handleRoot(AsyncWebServerRequest * request) {
-    String page = FPSTR(WC_HTTP_HEAD);
-    if (_page_title != NULL)
-        page.replace("{v}", _page_title);
-    else
-        page.replace("{v}", "WiFi Config Portal");
+/** Network scan. It runs in the background and is only ever polled from config_loop */
+static uint8_t rssiToQuality(int rssi) {
+    if (rssi <= -100)
+        return 0;
+    if (rssi >= -50)
+        return 100;
+    return 2 * (rssi + 100);
+}
 
-    page += FPSTR(WC_HTTP_SCRIPT);
-    page += FPSTR(WC_HTTP_STYLE);
-    page += _customHeadElement;
-    page += FPSTR(WC_HTTP_HEAD_END);
+void WIFIConfigBase::setScanInterval(unsigned long seconds) {
+    _scanInterval = seconds * 1000UL;
+}
 
-    page += FPSTR(WC_HTTP_FORM_START);
-    char parLength[5];
-    // add the extra parameters to the form
-    for (int i = 0; i < _paramsCount; i++) {
-        if (_params[i] == NULL) {
-            break;
-        }
+void WIFIConfigBase::setConnectCheck(unsigned long seconds) {
+    _connectCheck = seconds * 1000UL;
+}
+
+uint8_t WIFIConfigBase::getNetworkCount(void) {
+    return _networkCount[_networksFront];
+}
+
+const WIFIConfigNetwork* WIFIConfigBase::getNetwork(uint8_t i) {
+    uint8_t front = _networksFront;
+    if (i >= _networkCount[front])
+        return NULL;
+    return &_networks[front][i];
+}
+
+void WIFIConfigBase::updateScan(void) {
+    if (_scanInterval == 0)
+        return;
+
+    if (!_scanning) {
+        if (millis() - _lastScan < _scanInterval)
+            return;
+        _lastScan = millis();
+        // results get picked up on a later pass
+        if (WiFi.scanNetworks(true) == WIFI_SCAN_RUNNING)
+            _scanning = true;
+        return;
+    }
+
+    int8_t found = WiFi.scanComplete();
+    if (found == WIFI_SCAN_RUNNING)
+        return;
+    // a response is still going through the back table, the results keep until it's done
+    uint8_t back = _networksFront ^ 1;
+    if (found >= 0 && __atomic_load_n(&_networksPinned[back], __ATOMIC_SEQ_CST) != 0)
+        return;
+    _scanning = false;
+    _lastScan = millis();
+    if (found < 0)
+        return;
+
+    // fill the back table, deduplicated by SSID and sorted strongest first
+    WIFIConfigNetwork *table = _networks[back];
+    uint8_t count = 0;
 
-        String pitem = FPSTR(WC_HTTP_FORM_PARAM);
-        if (_params[i]->getID() != NULL) {
-            pitem.replace("{i}", _params[i]->getID());
-            pitem.replace("{n}", _params[i]->getID());
-            pitem.replace("{p}", _params[i]->getPlaceholder());
-            snprintf(parLength, 5, "%d", _params[i]->getValueLength());
-            pitem.replace("{l}", parLength);
-            pitem.replace("{v}", _params[i]->getValue());
-            pitem.replace("{c}", _params[i]->getCustomHTML());
-        } else {
-            pitem = _params[i]->getCustomHTML();
+    for (int i = 0; i < found; i++) {
+        String ssid = WiFi.SSID(i);
+        int rssi = WiFi.RSSI(i);
+        if (ssid.length() == 0 || ssid.length() > 32)
+            continue;
+
+        uint8_t pos;
+        for (pos = 0; pos < count; pos++) {
+            if (strcmp(table[pos].ssid, ssid.c_str()) == 0)
+                break;
+        }
+        if (pos < count) {
+            if (rssi <= table[pos].rssi)
+                continue;
+            // stronger sighting of a network we've already got, drop the old one
+            memmove(&table[pos], &table[pos + 1], (count - pos - 1) * sizeof(WIFIConfigNetwork));
+            count--;
         }
 
-        page += pitem;
+        for (pos = 0; pos < count && table[pos].rssi >= rssi; pos++)
+            ;
+        if (pos >= WIFICONFIG_MAX_NETWORKS)
+            continue;
+        if (count == WIFICONFIG_MAX_NETWORKS)
+            count--;
+        memmove(&table[pos + 1], &table[pos], (count - pos) * sizeof(WIFIConfigNetwork));
+
+        memset(table[pos].ssid, 0, sizeof(table[pos].ssid));
+        strncpy(table[pos].ssid, ssid.c_str(), sizeof(table[pos].ssid) - 1);
+        table[pos].rssi = rssi < -128 ? -128 : rssi;
+#if defined(ARDUINO_ARCH_ESP8266)
+        table[pos].secure = WiFi.encryptionType(i) != ENC_TYPE_NONE;
+#elif defined(ARDUINO_ARCH_ESP32)
+        table[pos].secure = WiFi.encryptionType(i) != WIFI_AUTH_OPEN;
+#endif
+        count++;
     }
-    if (_params[0] != NULL) {
-        page += "<br/>";
+    WiFi.scanDelete();
+
+    uint8_t front = _networksFront;
+    bool changed = count != _networkCount[front] ||
+            memcmp(table, _networks[front], count * sizeof(WIFIConfigNetwork)) != 0;
+
+    _networkCount[back] = count;
+    __atomic_store_n(&_networksFront, back, __ATOMIC_SEQ_CST);
+    if (changed) {
+        _pageGeneration++;
+        pushEvent(WC_EVENT_SCAN);
     }
 
-    page += FPSTR(WC_HTTP_FORM_END);
-    page += FPSTR(WC_HTTP_END);
+    WC_LOGD(SCAN_DONE, count, 0);
+}
 
-    AsyncWebServerResponse *response = request->beginResponse(200, "text/html", page);
-    response->addHeader("Content-Length", String(page.length()));
-    request->send(response);
+// pin the front table, so it isn't refilled until unpinNetworks()
+uint8_t WIFIConfigBase::pinNetworks(void) {
+    for (;;) {
+        uint8_t set = __atomic_load_n(&_networksFront, __ATOMIC_SEQ_CST);
+        __atomic_add_fetch(&_networksPinned[set], 1, __ATOMIC_SEQ_CST);
+        // still the front after the pin went in, so updateScan will see it before it next fills this one
+        if (__atomic_load_n(&_networksFront, __ATOMIC_SEQ_CST) == set)
+            return set;
+        __atomic_sub_fetch(&_networksPinned[set], 1, __ATOMIC_SEQ_CST);
+    }
+}
 
-    WC_DEBUG_PRINTLN("::Sent config page");
+void WIFIConfigBase::unpinNetworks(uint8_t set) {
+    __atomic_sub_fetch(&_networksPinned[set], 1, __ATOMIC_SEQ_CST);
 }
 
-/** Handle the WLAN save form and redirect to WLAN config page again */
-void WIFIConfig::handleWifiSave(AsyncWebServerRequest * request) {
-    WC_DEBUG_PRINTLN("::WiFi save");
+/* Page renderer: walks the page a fragment at a time and copies it straight into
+ * the response buffer, so a page never exists in RAM as a whole. Templates are
+ * walked segment by segment, with placeholder values copied out between the literal runs. */
+enum {
+    WC_PAGE_ROOT,
+    WC_PAGE_SAVED,
+    WC_PAGE_INFO,
+    WC_PAGE_RESET,
+    WC_PAGE_SCHEMA,     // /api/config parameter schema, JSON
+};
 
-    //SAVE/connect here
-    _ssid = request->arg("s").c_str();
-    _pass = request->arg("p").c_str();
+enum {
+    WC_ESC_NONE,
+    WC_ESC_HTML,
+    WC_ESC_JSON,
+};
 
-    //parameters
-    for (int i = 0; i < _paramsCount; i++) {
-        if (_params[i] == NULL) {
-            break;
-        }
-        //read parameter
-        String value = request->arg(_params[i]->getID()).c_str();
-        //store it in array
-        value.toCharArray(_params[i]->_value, _params[i]->_length + 1);
-        WC_DEBUG_PRINT("::Parameter: ");
-        WC_DEBUG_PRINT(_params[i]->getID()); WC_DEBUG_PRINT(": ");
-        WC_DEBUG_PRINTLN(value);
-    }
-
-    String page = FPSTR(WC_HTTP_HEAD);
-    page.replace("{v}", "Credentials Saved");
-    page += FPSTR(WC_HTTP_SCRIPT);
-    page += FPSTR(WC_HTTP_STYLE);
-    page += _customHeadElement;
-    page += FPSTR(WC_HTTP_HEAD_END);
-    page += FPSTR(WC_HTTP_SAVED);
-    page += FPSTR(WC_HTTP_END);
-
-    AsyncWebServerResponse *response = request->beginResponse(200, "text/html", page);
-    response->addHeader("Content-Length", String(page.length()));
-    request->send(response);
+// JSON string escape for 'c', written into 'ent', or NULL if it goes out as-is
+static const char* jsonEscape(char c, char ent[7]) {
+    if (c == '"' || c == '\\') {
+        ent[0] = '\\';
+        ent[1] = c;
+        ent[2] = 0;
+        return ent;
+    }
+    if ((uint8_t)c < 0x20) {
+        snprintf(ent, 7, "\\u%04x", (uint8_t)c);
+        return ent;
+    }
+    return NULL;
+}
+
+class WIFIConfigPage {
+  public:
+    WIFIConfigPage(WIFIConfigBase *wc, uint8_t kind);
+    ~WIFIConfigPage();
+
+    // fill at most 'maxLen' bytes of the page, returns 0 once it's all been sent
+    size_t        fill(uint8_t *buf, size_t maxLen);
+#if defined(WC_ENABLE_STATS)
+    // count the page towards 'route' once it's been produced in full, timed from 'start'
+    void          timeRoute(uint8_t route, uint32_t start) { _statsRoute = route; _statsStart = start; }
+#endif
+  private:
+    WIFIConfigBase *_wc;
+    uint8_t       _kind;
+    uint8_t       _step   = 0;      // position in the page
+    int           _param  = 0;      // current form parameter
+    uint8_t       _netSet = 0;      // scan table being listed, and the current entry in it
+    uint8_t       _net    = 0;
+    bool          _pinned = false;  // holding _netSet
+
+    // template being copied out
+    const char      *_tpl     = NULL;
+    const WCSegment *_segs    = NULL;
+    uint8_t          _segCount = 0;
+    uint8_t          _segIdx   = 0;
+    bool             _segSlot  = false;   // literal run of the current segment is out, slot is next
+    bool             _tplPgm   = false;   // template and its segments are in PROGMEM
+    uint8_t          _tplKind  = 0;
+
+    const char   *_val    = NULL;   // plain fragment or placeholder value being copied out
+    size_t        _valLen = 0;
+    size_t        _valPos = 0;
+    bool          _valPgm = false;
+    uint8_t       _valEsc = WC_ESC_NONE;  // how the value is escaped on the way out
+    uint8_t       _escPos = 0;      // how much of the current entity has gone out
+    char          _ent[7];          // current JSON escape
+    uint8_t       _sub    = 0;      // position within the current schema entry
+    bool          _comma  = false;  // a schema entry has gone out, the next one needs a comma
+
+    char          _scratch[20];     // formatted numbers and addresses
+#if defined(WC_ENABLE_STATS)
+    char          _line[128];       // one piece of the stats section
+    uint8_t       _part   = 0;
+    uint8_t       _statsRoute = WIFICONFIG_ROUTE_COUNT;
+    uint32_t      _statsStart = 0;
+    uint32_t      _statsEnd   = 0;
+    bool          _statsDone  = false;
+#endif
 
-    WC_DEBUG_PRINTLN("::Sent wifi save page");
+    void          setTemplate(uint8_t kind, const char *tpl, const WCSegment *segs, uint8_t count, bool pgm = true);
+    void          setValue(const char *val, bool pgm = false);
+    void          setValue(const char *val, size_t len, bool pgm);
+    const char   *entity(char c);
+    bool          nextSchema(void);
+    const char   *title(void);
+    const char   *slot(char c);
+    bool          nextSegment(void);
+    bool          next(void);
+};
 
-    recvd_config = true; //signal ready to connect/reset
+WIFIConfigPage::WIFIConfigPage(WIFIConfigBase *wc, uint8_t kind) : _wc(wc), _kind(kind) {
+    _scratch[0] = 0;
 }
 
-/** Handle the info page */
-void WIFIConfig::handleInfo(AsyncWebServerRequest * request) {
-    WC_DEBUG_PRINTLN("::Info");
-
-    String page = FPSTR(WC_HTTP_HEAD);
-    page.replace("{v}", "Info");
-    page += FPSTR(WC_HTTP_SCRIPT);
-    page += FPSTR(WC_HTTP_STYLE);
-    page += _customHeadElement;
-    page += FPSTR(WC_HTTP_HEAD_END);
-    page += F("<dl>");
-    page += F("<dt>Soft AP IP</dt><dd>");
-    page += WiFi.softAPIP().toString();
-    page += F("</dd>");
-    page += F("<dt>Soft AP MAC</dt><dd>");
-    page += WiFi.softAPmacAddress();
-    page += F("</dd>");
-    page += F("<dt>Station MAC</dt><dd>");
-    page += WiFi.macAddress();
-    page += F("</dd>");
-    page += F("</dl>");
-    page += FPSTR(WC_HTTP_END);
-
-    AsyncWebServerResponse *response = request->beginResponse(200, "text/html", page);
-    response->addHeader("Content-Length", String(page.length()));
-    request->send(response);
+WIFIConfigPage::~WIFIConfigPage() {
+    // the client went before the list was out
+    if (_pinned)
+        _wc->unpinNetworks(_netSet);
+#if defined(WC_ENABLE_STATS)
+    // only pages that made it out in full
+    if (_statsDone && _statsRoute < WIFICONFIG_ROUTE_COUNT)
+        _wc->recordRoute(_statsRoute, _statsEnd - _statsStart);
+#endif
+}
+
+enum {
+    WC_TPL_HEAD,
+    WC_TPL_PARAM,
+    WC_TPL_ITEM,
+};
 
-    WC_DEBUG_PRINTLN("Sent info page");
+void WIFIConfigPage::setTemplate(uint8_t kind, const char *tpl, const WCSegment *segs, uint8_t count, bool pgm) {
+    _tplKind = kind;
+    _tpl = tpl;
+    _segs = segs;
+    _segCount = count;
+    _segIdx = 0;
+    _segSlot = false;
+    _tplPgm = pgm;
 }
 
-/** Handle the reset page */
-void WIFIConfig::handleReset(AsyncWebServerRequest * request) {
-    WC_DEBUG_PRINTLN("::Reset");
-
-    String page = FPSTR(WC_HTTP_HEAD);
-    page.replace("{v}", "Info");
-    page += FPSTR(WC_HTTP_SCRIPT);
-    page += FPSTR(WC_HTTP_STYLE);
-    page += _customHeadElement;
-    page += FPSTR(WC_HTTP_HEAD_END);
-    page += F("Module will reset in a few seconds.");
-    page += FPSTR(WC_HTTP_END);
-
-    AsyncWebServerResponse *response = request->beginResponse(200, "text/html", page);
-    response->addHeader("Content-Length", String(page.length()));
-    request->send(response);
+void WIFIConfigPage::setValue(const char *val, bool pgm) {
+    if (val == NULL)
+        val = "";
+    setValue(val, pgm ? strlen_P(val) : strlen(val), pgm);
+}
 
-    WC_DEBUG_PRINTLN("::Sent reset page");
-    delay(5000);
-    ESP.restart();
-    delay(2000);
+void WIFIConfigPage::setValue(const char *val, size_t len, bool pgm) {
+    _val = val;
+    _valLen = len;
+    _valPos = 0;
+    _valPgm = pgm;
+    _valEsc = WC_ESC_NONE;
+    _escPos = 0;
 }
 
-void WIFIConfig::handleNotFound(AsyncWebServerRequest * request) {
-    request->redirect("/");
+// what 'c' turns into in the current value's escaping, NULL if it goes out as-is
+const char* WIFIConfigPage::entity(char c) {
+    if (_valEsc == WC_ESC_HTML) {
+        switch (c) {
+            case '<':  return "&lt;";
+            case '>':  return "&gt;";
+            case '&':  return "&amp;";
+            case '\'': return "&#39;";
+            case '"':  return "&quot;";
+            default:   return NULL;
+        }
+    }
+
+    return jsonEscape(c, _ent);
 }
 
-//start up save config callback
-void WIFIConfig::setSaveConfigCallback( void (*func)(void) ) {
-    _savecallback = func;
+// queue up the literal run or slot value next in the template, false once the template is done
+bool WIFIConfigPage::nextSegment(void) {
+    WCSegment seg;
+
+    if (_segIdx >= _segCount)
+        return false;
+
+    if (_tplPgm)
+        memcpy_P(&seg, _segs + _segIdx, sizeof(seg));
+    else
+        seg = _segs[_segIdx];
+
+    if (!_segSlot) {
+        setValue(_tpl + seg.offset, seg.length, _tplPgm);
+        _segSlot = true;
+        return true;
+    }
+
+    _segIdx++;
+    _segSlot = false;
+    setValue(seg.slot != 0 ? slot(seg.slot) : "");
+    // network names come from whoever's nearby, so they get escaped
+    if (_tplKind == WC_TPL_ITEM && seg.slot == 'v')
+        _valEsc = WC_ESC_HTML;
+    return true;
 }
 
-//sets a custom element to add to head, like a new style tag
-void WIFIConfig::setCustomHeadElement(const char* element) {
-    _customHeadElement = element;
+const char* WIFIConfigPage::title(void) {
+    switch (_kind) {
+        case WC_PAGE_ROOT:
+            return _wc->_page_title != NULL ? _wc->_page_title : "WiFi Config Portal";
+        case WC_PAGE_SAVED:
+            return "Credentials Saved";
+        default:
+            return "Info";
+    }
 }
 
-void WIFIConfig::cleanup(void) {
-    dnsServer->stop();
-    dnsServer.reset();
-    WiFi.softAPdisconnect(true);
-    WiFi.mode(WIFI_STA);
+// value of a placeholder in the current template
+const char* WIFIConfigPage::slot(char c) {
+    if (_tplKind == WC_TPL_HEAD)
+        return c == 'v' ? title() : "";
+
+    if (_tplKind == WC_TPL_ITEM) {
+        const WIFIConfigNetwork *net = &_wc->_networks[_netSet][_net];
+        switch (c) {
+            case 'v':
+                return net->ssid;
+            case 'i':
+                return net->secure ? "l" : "";
+            case 'r':
+                snprintf(_scratch, sizeof(_scratch), "%u", rssiToQuality(net->rssi));
+                return _scratch;
+            default:
+                return "";
+        }
+    }
+
+    WIFIConfigParam *p = _wc->_params[_param];
+    switch (c) {
+        case 'i':
+        case 'n':
+            return p->getID();
+        case 'p':
+            return p->getPlaceholder();
+        case 'l':
+            snprintf(_scratch, sizeof(_scratch), "%d", p->getValueLength());
+            return _scratch;
+        case 'v':
+            return p->getValue();
+        case 'c':
+            return p->getCustomHTML();
+        default:
+            return "";
+    }
+}
+
+static void formatMAC(char *buf, size_t len, const uint8_t *mac) {
+    snprintf(buf, len, "%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
+// queue up the next fragment of the page, false once the page is complete
+bool WIFIConfigPage::next(void) {
+    uint8_t mac[6];
+    IPAddress ip;
+
+    if (_kind == WC_PAGE_SCHEMA)
+        return nextSchema();
+
+    // head is common to all pages
+    switch (_step) {
+        case 0: _step++; setTemplate(WC_TPL_HEAD, WC_HTTP_HEAD, WC_HEAD_SEGS, WC_ARRAY_LEN(WC_HEAD_SEGS)); return true;
+        case 1: _step++; setValue(WC_HTTP_ASSETS, true); return true;
+        case 2:
+            _step++;
+            setTemplate(WC_TPL_HEAD, _wc->_customHeadElement, _wc->_customHeadSegs, _wc->_customHeadSegCount, false);
+            return true;
+        case 3: _step++; setValue(WC_HTTP_HEAD_END, true); return true;
+        default: break;
+    }
+
+    if (_kind == WC_PAGE_ROOT) {
+        switch (_step) {
+            case 4:
+                _step++;
+                _netSet = _wc->pinNetworks();
+                _pinned = true;
+                setValue(PSTR("<div id='n'>"), true);
+                return true;
+            case 5:
+                // list nearby networks from the last scan
+                if (_net < _wc->_networkCount[_netSet]) {
+                    setTemplate(WC_TPL_ITEM, WC_HTTP_ITEM, WC_ITEM_SEGS, WC_ARRAY_LEN(WC_ITEM_SEGS));
+                    return true;
+                }
+                _step++;
+                _wc->unpinNetworks(_netSet);
+                _pinned = false;
+                setValue(PSTR("</div>"), true);
+                return true;
+            case 6: _step++; setValue(WC_HTTP_FORM_START, true); return true;
+            case 7:
+                // add the extra parameters to the form, one at a time
+                if (_param < _wc->_paramsCount && _wc->_params[_param] != NULL) {
+                    if (_wc->_params[_param]->getID() != NULL) {
+                        setTemplate(WC_TPL_PARAM, WC_HTTP_FORM_PARAM, WC_FORM_PARAM_SEGS, WC_ARRAY_LEN(WC_FORM_PARAM_SEGS));
+                    } else {
+                        setValue(_wc->_params[_param]->getCustomHTML());
+                        _param++;
+                    }
+                    return true;
+                }
+                _step++;
+                if (_wc->_paramsCount > 0) {
+                    setValue("<br/>");
+                    return true;
+                }
+                // fall through
+            case 8: _step = 9; setValue(WC_HTTP_FORM_END, true); return true;
+            case 9: _step++; setValue(WC_HTTP_END, true); return true;
+            default: return false;
+        }
+    }
+    else if (_kind == WC_PAGE_SAVED) {
+        switch (_step) {
+            case 4: _step++; setValue(WC_HTTP_SAVED, true); return true;
+            case 5: _step++; setValue(WC_HTTP_END, true); return true;
+            default: return false;
+        }
+    }
+    else if (_kind == WC_PAGE_INFO) {
+        switch (_step) {
+            case 4: _step++; setValue(PSTR("<dl><dt>Soft AP IP</dt><dd>"), true); return true;
+            case 5:
+                _step++;
+                ip = WiFi.softAPIP();
+                snprintf(_scratch, sizeof(_scratch), "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+                setValue(_scratch);
+                return true;
+            case 6: _step++; setValue(PSTR("</dd><dt>Soft AP MAC</dt><dd>"), true); return true;
+            case 7:
+                _step++;
+                formatMAC(_scratch, sizeof(_scratch), WiFi.softAPmacAddress(mac));
+                setValue(_scratch);
+                return true;
+            case 8: _step++; setValue(PSTR("</dd><dt>Station MAC</dt><dd>"), true); return true;
+            case 9:
+                _step++;
+                formatMAC(_scratch, sizeof(_scratch), WiFi.macAddress(mac));
+                setValue(_scratch);
+                return true;
+            case 10: _step++; setValue(PSTR("</dd></dl>"), true); return true;
+            case 11:
+#if defined(WC_ENABLE_STATS)
+                // machine-readable copy of the stats, for fleet tooling
+                if (_wc->formatStats(_line, sizeof(_line), _part) > 0) {
+                    _part++;
+                    setValue(_line);
+                    return true;
+                }
+#endif
+                _step++;
+                // fall through
+            case 12: _step++; setValue(WC_HTTP_END, true); return true;
+            default: return false;
+        }
+    }
+    else {
+        switch (_step) {
+            case 4: _step++; setValue(PSTR("Module will reset in a few seconds."), true); return true;
+            case 5: _step++; setValue(WC_HTTP_END, true); return true;
+            default: return false;
+        }
+    }
+}
+
+#define WC_XSTR(x)  WC_STR(x)
+#define WC_STR(x)   #x
+
+/* {"ssid":{"max":32},"pass":{"max":64},"params":[{"id":"..","max":N,"value":".."},...]}, "value" being what the
+ * parameter holds now, i.e. its default until a config's been submitted or loaded */
+bool WIFIConfigPage::nextSchema(void) {
+    WIFIConfigParam *p;
+
+    switch (_step) {
+        case 0:
+            _step++;
+            setValue(PSTR("{\"ssid\":{\"max\":" WC_XSTR(WC_SSID_MAX_LEN) "},\"pass\":{\"max\":" WC_XSTR(WC_PASS_MAX_LEN) "},\"params\":["), true);
+            return true;
+        case 1:
+            // parameters with an ID, i.e. form fields, a piece at a time
+            while (_param < _wc->_paramsCount && (_wc->_params[_param] == NULL || _wc->_params[_param]->getID() == NULL))
+                _param++;
+            if (_param < _wc->_paramsCount) {
+                p = _wc->_params[_param];
+                switch (_sub++) {
+                    case 0:
+                        setValue(_comma ? ",{\"id\":\"" : "{\"id\":\"");
+                        _comma = true;
+                        return true;
+                    case 1:
+                        setValue(p->getID());
+                        _valEsc = WC_ESC_JSON;
+                        return true;
+                    case 2:
+                        snprintf(_scratch, sizeof(_scratch), "\",\"max\":%d", p->getValueLength());
+                        setValue(_scratch);
+                        return true;
+                    case 3:
+                        setValue(",\"value\":\"");
+                        return true;
+                    case 4:
+                        setValue(p->getValue());
+                        _valEsc = WC_ESC_JSON;
+                        return true;
+                    default:
+                        _sub = 0;
+                        _param++;
+                        setValue("\"}");
+                        return true;
+                }
+            }
+            _step++;
+            setValue("]}");
+            return true;
+        default:
+            return false;
+    }
+}
+
+size_t WIFIConfigPage::fill(uint8_t *buf, size_t maxLen) {
+    size_t n = 0;
+
+    while (n < maxLen) {
+        // drain the current fragment/placeholder value first
+        if (_val != NULL && _valEsc != WC_ESC_NONE) {
+            while (n < maxLen && _valPos < _valLen) {
+                char c = _val[_valPos];
+                const char *ent = entity(c);
+                if (ent == NULL) {
+                    buf[n++] = c;
+                    _valPos++;
+                    continue;
+                }
+                // an entity may straddle two chunks
+                size_t elen = strlen(ent);
+                size_t len = elen - _escPos;
+                if (len > maxLen - n)
+                    len = maxLen - n;
+                memcpy(buf + n, ent + _escPos, len);
+                n += len;
+                _escPos += len;
+                if (_escPos == elen) {
+                    _escPos = 0;
+                    _valPos++;
+                }
+            }
+            if (_valPos == _valLen)
+                _val = NULL;
+            continue;
+        }
+        if (_val != NULL) {
+            size_t len = _valLen - _valPos;
+            if (len > maxLen - n)
+                len = maxLen - n;
+            if (_valPgm)
+                memcpy_P(buf + n, _val + _valPos, len);
+            else
+                memcpy(buf + n, _val + _valPos, len);
+            n += len;
+            _valPos += len;
+            if (_valPos == _valLen)
+                _val = NULL;
+            continue;
+        }
+
+        // then carry on with the template
+        if (_tpl != NULL) {
+            if (!nextSegment()) {
+                if (_tplKind == WC_TPL_PARAM)
+                    _param++;
+                else if (_tplKind == WC_TPL_ITEM)
+                    _net++;
+                _tpl = NULL;
+            }
+            continue;
+        }
+
+        if (!next()) {
+#if defined(WC_ENABLE_STATS)
+            if (!_statsDone) {
+                _statsEnd = micros();
+                _statsDone = true;
+            }
+#endif
+            break;
+        }
+    }
+
+    return n;
+}
+
+/* Page cache: whole rendered pages, for clients that keep asking for the same page.
+ * Each entry is keyed on everything the page depends on, and carries a strong ETag
+ * so repeat requests can be answered with a bodiless 304. */
+struct WCCachedPage {
+    uint32_t      key;
+    uint32_t      etag;
+    size_t        len;
+    uint8_t       data[1];
+};
+
+// identifies the current content of the pages: the parameter list, custom head and parameter values
+uint32_t WIFIConfigBase::pageKey(void) {
+    uint32_t gen = _pageGeneration;
+    uint32_t h = fnv1a(2166136261UL, &gen, sizeof(gen));
+    for (int i = 0; i < _paramsCount; i++) {
+        if (_params[i] == NULL || _params[i]->_value == NULL)
+            continue;
+        h = fnv1a(h, _params[i]->_value, strlen(_params[i]->_value) + 1);
+    }
+    return h;
+}
+
+void WIFIConfigBase::setPageCacheSize(size_t bytes) {
+    _pageCacheSize = bytes;
+    _pageGeneration++;
+}
+
+// serve a page from the cache, rendering it there first if needed. false if the page doesn't fit in the cache
+bool WIFIConfigBase::sendCachedPage(AsyncWebServerRequest * request, uint8_t kind) {
+    if (_pageCacheSize == 0) {
+        for (size_t i = 0; i < sizeof(_pageCache) / sizeof(_pageCache[0]); i++)
+            _pageCache[i].reset();
+        return false;
+    }
+    // only the root, saved and info pages are cached
+    if (kind >= sizeof(_pageCache) / sizeof(_pageCache[0]))
+        return false;
+#if defined(WC_ENABLE_STATS)
+    // the info page carries live stats
+    if (kind == WC_PAGE_INFO)
+        return false;
+#endif
+
+    uint32_t key = pageKey();
+    std::shared_ptr<WCCachedPage> &entry = _pageCache[kind];
+    if (entry && entry->key != key)
+        entry.reset();
+
+    if (!entry) {
+        size_t used = 0;
+        for (size_t i = 0; i < sizeof(_pageCache) / sizeof(_pageCache[0]); i++) {
+            if (_pageCache[i] && _pageCache[i]->key != key)
+                _pageCache[i].reset();
+            if (_pageCache[i])
+                used += _pageCache[i]->len;
+        }
+
+        // size the page with a dry run, then render it for real into an exact-size buffer
+        uint8_t tmp[64];
+        size_t len = 0, n;
+        WIFIConfigPage sizing(this, kind);
+        while ((n = sizing.fill(tmp, sizeof(tmp))) > 0)
+            len += n;
+        if (used + len > _pageCacheSize)
+            return false;
+
+        WCCachedPage *page = (WCCachedPage *)malloc(sizeof(WCCachedPage) + len);
+        if (page == NULL)
+            return false;
+        WIFIConfigPage render(this, kind);
+        if (render.fill(page->data, len) != len || pageKey() != key) {
+            // changed under us, don't keep it
+            free(page);
+            return false;
+        }
+        page->key = key;
+        page->len = len;
+        page->etag = fnv1a(2166136261UL, page->data, len);
+        entry = std::shared_ptr<WCCachedPage>(page, free);
+    }
+
+    char etag[11];
+    snprintf(etag, sizeof(etag), "\"%08lx\"", (unsigned long)entry->etag);
+
+    AsyncWebServerResponse *response;
+    AsyncWebHeader *match = request->getHeader("If-None-Match");
+    if (match != NULL && match->value() == etag) {
+        response = request->beginResponse(304);
+    } else {
+        // the response holds on to the entry, so it survives being dropped from the cache mid-send
+        std::shared_ptr<WCCachedPage> page = entry;
+        response = request->beginResponse("text/html", page->len,
+            [page](uint8_t *buf, size_t maxLen, size_t index) -> size_t {
+                size_t len = page->len - index;
+                if (len > maxLen)
+                    len = maxLen;
+                memcpy(buf, page->data + index, len);
+                return len;
+            });
+    }
+    response->addHeader("ETag", etag);
+    response->addHeader("Cache-Control", "no-cache");
+    request->send(response);
+    return true;
+}
+
+void WIFIConfigBase::sendPage(AsyncWebServerRequest * request, uint8_t kind, uint8_t route, uint32_t start) {
+    if (sendCachedPage(request, kind)) {
+#if defined(WC_ENABLE_STATS)
+        // rendered up front if at all, the rest is a copy
+        if (route < WIFICONFIG_ROUTE_COUNT)
+            recordRoute(route, micros() - start);
+#endif
+        return;
+    }
+
+    /* each page being streamed holds a renderer plus the response's buffers until the client's had it all.
+     * The saved page answers a config that's already been taken, and the schema an API client that has
+     * no page to retry from, so those two always go out; they still count towards the cap */
+    bool capped = kind != WC_PAGE_SAVED && kind != WC_PAGE_SCHEMA;
+    if (capped && _maxRenders != 0 && _rendersInFlight >= _maxRenders) {
+        AsyncWebServerResponse *response = request->beginResponse(503, "text/plain", "Busy");
+        response->addHeader("Retry-After", "1");
+        request->send(response);
+        return;
+    }
+
+    // the renderer is owned by the response and freed along with it, which frees up its render slot
+    _rendersInFlight++;
+    std::shared_ptr<WIFIConfigPage> page(new WIFIConfigPage(this, kind), [this](WIFIConfigPage *p) {
+        delete p;
+        _rendersInFlight--;
+    });
+#if defined(WC_ENABLE_STATS)
+    page->timeRoute(route, start);
+#else
+    (void)route;
+    (void)start;
+#endif
+    AsyncWebServerResponse *response = request->beginChunkedResponse(kind == WC_PAGE_SCHEMA ? "application/json" : "text/html",
+        [page](uint8_t *buf, size_t maxLen, size_t /*index*/) -> size_t {
+            return page->fill(buf, maxLen);
+        });
+    request->send(response);
+}
+
+void WIFIConfigBase::setMaxConcurrentRenders(uint8_t renders) {
+    _maxRenders = renders;
+}
+
+void WIFIConfigBase::setRequestRateLimit(uint8_t perSecond) {
+    _rateLimit = perSecond;
+}
+
+bool WIFIConfigBase::admitClient(AsyncWebServerRequest * request) {
+    if (_rateLimit == 0)
+        return true;
+
+    uint32_t ip = request->client()->remoteIP();
+    unsigned long now = millis();
+    uint8_t slot = 0;
+    for (uint8_t i = 0; i < WIFICONFIG_RATE_CLIENTS; i++) {
+        if (_clients[i].ip == ip) {
+            slot = i;
+            break;
+        }
+        // otherwise whoever's been quiet the longest
+        if (now - _clients[i].windowStart > now - _clients[slot].windowStart)
+            slot = i;
+    }
+
+    if (_clients[slot].ip != ip || now - _clients[slot].windowStart >= 1000) {
+        _clients[slot].ip = ip;
+        _clients[slot].windowStart = now;
+        _clients[slot].count = 0;
+    }
+    if (_clients[slot].count >= _rateLimit) {
+        AsyncWebServerResponse *response = request->beginResponse(429, "text/plain", "Slow down");
+        response->addHeader("Retry-After", "1");
+        request->send(response);
+        return false;
+    }
+    _clients[slot].count++;
+    return true;
+}
+
+/** Wifi config page handler */
+void WIFIConfigBase::handleRoot(AsyncWebServerRequest * request) {
+    if (!admitClient(request))
+        return;
+    WC_STATS_BEGIN();
+    sendPage(request, WC_PAGE_ROOT, WIFICONFIG_ROUTE_ROOT, WC_STATS_T0);
+    WC_LOGD(PAGE_SENT, "config page", 0);
+}
+
+/* Staged config records: the SSID, the passkey, then each parameter's value, all nul-terminated */
+#define WC_REC_SSID     0
+#define WC_REC_PASS     (WC_SSID_MAX_LEN + 1)
+#define WC_REC_PARAMS   (WC_REC_PASS + WC_PASS_MAX_LEN + 1)
+
+// lay out the records for the current parameter list and allocate the ring
+bool WIFIConfigBase::allocStage(void) {
+    freeStage();
+
+    size_t size = WC_REC_PARAMS;
+    for (int i = 0; i < _paramsCount; i++) {
+        WIFIConfigParam *p = _params[i];
+        p->_stageOffset = 0;
+        if (p->_value == NULL || p->_length <= 0 || size + p->_length + 1 > UINT16_MAX)
+            continue;
+        p->_stageOffset = size;
+        size += p->_length + 1;
+    }
+    // keep every record word-aligned
+    _recordSize = (size + 3) & ~(size_t)3;
+
+    _stage = (char *)malloc(_recordSize * WC_STAGE_SLOTS);
+    if (_stage == NULL) {
+        WC_LOGE(NO_STAGE_MEMORY, 0, 0);
+        return false;
+    }
+    for (int i = 0; i < WC_STAGE_SLOTS; i++)
+        __atomic_store_n(&_slotState[i], (uint32_t)WC_SLOT_FREE, __ATOMIC_RELAXED);
+    return true;
+}
+
+void WIFIConfigBase::freeStage(void) {
+    char *stage = _stage;
+    _stage = NULL;
+    free(stage);
+}
+
+// web task only: a free slot, cleared and marked WRITING, or -1 if they're all taken
+int WIFIConfigBase::claimRecord(void) {
+    if (_stage == NULL)
+        return -1;
+    for (int i = 0; i < WC_STAGE_SLOTS; i++) {
+        if (__atomic_load_n(&_slotState[i], __ATOMIC_ACQUIRE) != WC_SLOT_FREE)
+            continue;
+        __atomic_store_n(&_slotState[i], (uint32_t)WC_SLOT_WRITING, __ATOMIC_RELAXED);
+        // anything not submitted ends up empty
+        memset(stageRecord(i), 0, _recordSize);
+        return i;
+    }
+    return -1;
+}
+
+// web task only: hand a complete record over to config_loop
+void WIFIConfigBase::publishRecord(int slot) {
+    uint32_t seq = _stageSeq++;
+    if (_stageSeq < WC_SLOT_READY)
+        _stageSeq = WC_SLOT_READY;
+    __atomic_store_n(&_slotState[slot], seq, __ATOMIC_RELEASE);
+}
+
+// web task only: drop a record that won't be published
+void WIFIConfigBase::releaseRecord(int slot) {
+    __atomic_store_n(&_slotState[slot], (uint32_t)WC_SLOT_FREE, __ATOMIC_RELEASE);
+}
+
+bool WIFIConfigBase::commitRecord(void) {
+    int latest = -1;
+    uint32_t latestSeq = 0;
+    for (int i = 0; i < WC_STAGE_SLOTS; i++) {
+        uint32_t state = __atomic_load_n(&_slotState[i], __ATOMIC_ACQUIRE);
+        if (state < WC_SLOT_READY)
+            continue;
+        if (latest < 0 || (int32_t)(state - latestSeq) > 0) {
+            latest = i;
+            latestSeq = state;
+        }
+    }
+    if (latest < 0)
+        return false;
+
+    const char *record = stageRecord(latest);
+    memcpy(_ssid, record + WC_REC_SSID, sizeof(_ssid));
+    memcpy(_pass, record + WC_REC_PASS, sizeof(_pass));
+    for (int i = 0; i < _paramsCount; i++) {
+        WIFIConfigParam *p = _params[i];
+        // no buffer means no slot in the record, but don't count on it
+        if (p->_stageOffset == 0 || p->_value == NULL)
+            continue;
+        memcpy(p->_value, record + p->_stageOffset, p->_length + 1);
+        // the buffer can change again before this is printed, so not the value itself
+        WC_LOGD(PARAM_COMMITTED, p->getID(), strlen(p->_value));
+    }
+
+    // that one, and anything older, are done with
+    for (int i = 0; i < WC_STAGE_SLOTS; i++) {
+        uint32_t state = __atomic_load_n(&_slotState[i], __ATOMIC_ACQUIRE);
+        if (state >= WC_SLOT_READY && (int32_t)(state - latestSeq) <= 0)
+            __atomic_store_n(&_slotState[i], (uint32_t)WC_SLOT_FREE, __ATOMIC_RELEASE);
+    }
+    return true;
+}
+
+int WIFIConfigBase::fieldIndex(const char *key, size_t keyLen) {
+    if (keyLen == 1 && key[0] == 's')
+        return 0;
+    if (keyLen == 1 && key[0] == 'p')
+        return 1;
+    int idx = findParam(key, keyLen);
+    return idx < 0 ? -1 : 2 + idx;
+}
+
+/** Submitted fields: SSID, passkey and parameters each to their own spot in the record */
+char* WIFIConfigBase::recordField(char *record, const char *key, size_t keyLen, size_t *cap) {
+    int field = fieldIndex(key, keyLen);
+    if (field == 0) {
+        *cap = WC_SSID_MAX_LEN;
+        return record + WC_REC_SSID;
+    }
+    if (field == 1) {
+        *cap = WC_PASS_MAX_LEN;
+        return record + WC_REC_PASS;
+    }
+
+    if (field < 0 || _params[field - 2]->_stageOffset == 0)
+        return NULL;
+    WIFIConfigParam *p = _params[field - 2];
+    *cap = p->_length;
+    return record + p->_stageOffset;
+}
+
+/* per-request staging state, kept in the request's _tempObject and released with free() */
+struct WCConfigStage : public WCFieldSink {
+    WIFIConfigBase *wc;
+    int           slot;         // -1 once published or released, or if there was no free slot
+
+    char *fieldBuffer(const char *key, size_t keyLen, size_t *cap) override {
+        return slot < 0 ? NULL : wc->recordField(wc->stageRecord(slot), key, keyLen, cap);
+    }
+
+    void publish(void) {
+        if (slot >= 0)
+            wc->publishRecord(slot);
+        slot = -1;
+    }
+
+    void release(void) {
+        if (slot >= 0)
+            wc->releaseRecord(slot);
+        slot = -1;
+    }
+};
+
+struct WCFormUpload : public WCConfigStage {
+    WCFormParser  parser;
+};
+
+/** Routes, all served by the one dispatcher below. Anything not in here goes to handleNotFound */
+const WIFIConfigBase::WCRoute WIFIConfigBase::_routes[] = {
+    { "/",              HTTP_ANY,   &WIFIConfigBase::handleRoot,            NULL },
+    { "/wifisave",      HTTP_ANY,   &WIFIConfigBase::handleWifiSave,        &WIFIConfigBase::handleWifiSaveBody },
+    { "/api/config",    HTTP_GET,   &WIFIConfigBase::handleConfigSchema,    NULL },
+    { "/api/config",    HTTP_POST,  &WIFIConfigBase::handleConfigUpload,    &WIFIConfigBase::handleConfigUploadBody },
+    { "/i",             HTTP_ANY,   &WIFIConfigBase::handleInfo,            NULL },
+    { "/r",             HTTP_ANY,   &WIFIConfigBase::handleReset,           NULL },
+    { "/s.css",         HTTP_GET,   &WIFIConfigBase::handleStyle,           NULL },
+    { "/s.js",          HTTP_GET,   &WIFIConfigBase::handleScript,          NULL },
+    { "/scan",          HTTP_GET,   &WIFIConfigBase::handleScan,            NULL },
+};
+
+const WIFIConfigBase::WCRoute* WIFIConfigBase::findRoute(AsyncWebServerRequest * request) {
+    const String &url = request->url();
+    for (size_t i = 0; i < WC_ARRAY_LEN(_routes); i++) {
+        if ((request->method() & _routes[i].methods) && url == _routes[i].uri)
+            return &_routes[i];
+    }
+    return NULL;
+}
+
+/* Takes every request the server gets */
+class WIFIConfigHandler : public AsyncWebHandler {
+  public:
+    WIFIConfigHandler(WIFIConfigBase *wc) : _wc(wc) {}
+
+    // the connection's already counted, see WIFIConfigServer
+    bool canHandle(AsyncWebServerRequest * /*request*/) override {
+        return true;
+    }
+
+    void handleRequest(AsyncWebServerRequest *request) override {
+        const WIFIConfigBase::WCRoute *route = _wc->findRoute(request);
+        if (route != NULL)
+            (_wc->*route->onRequest)(request);
+        else
+            _wc->handleNotFound(request);
+    }
+
+    void handleBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) override {
+        const WIFIConfigBase::WCRoute *route = _wc->findRoute(request);
+        if (route != NULL && route->onBody != NULL)
+            (_wc->*route->onBody)(request, data, len, index, total);
+    }
+
+    // form posts still need their parameters parsed
+    bool isRequestHandlerTrivial() override { return false; }
+
+  private:
+    WIFIConfigBase *_wc;
+};
+
+AsyncWebHandler* WIFIConfigBase::newDispatcher(void) {
+    return new WIFIConfigHandler(this);
+}
+
+/* AsyncWebServer's own accept handler, plus the count. A connection's counted until it closes,
+ * which is also when anything it staged but didn't publish goes back */
+WIFIConfigServer::WIFIConfigServer(WIFIConfigBase *wc) : AsyncWebServer(80) {
+    _server.onClient([wc](void *s, AsyncClient *c) {
+        if (c == NULL)
+            return;
+        c->setRxTimeout(3);
+        AsyncWebServerRequest *r = new AsyncWebServerRequest((AsyncWebServer *)s, c);
+        if (r == NULL) {
+            c->close(true);
+            c->free();
+            delete c;
+            return;
+        }
+        __atomic_add_fetch(&wc->_requestsLive, 1, __ATOMIC_ACQ_REL);
+#if defined(WC_ENABLE_STATS)
+        if (wc->_stats.firstClientMs == 0) {
+            uint32_t ms = millis() - wc->_statsStart;
+            wc->_stats.firstClientMs = ms > 0 ? ms : 1;
+        }
+#endif
+        r->onDisconnect([wc, r]() {
+            // only the staged routes use _tempObject
+            if (r->_tempObject != NULL)
+                ((WCConfigStage *)r->_tempObject)->release();
+            __atomic_sub_fetch(&wc->_requestsLive, 1, __ATOMIC_RELEASE);
+        });
+    }, this);
+}
+
+bool WIFIConfigBase::releaseServer(void) {
+    if (_server == NULL)
+        return true;
+    // it's stopped listening, so this can only go down
+    if (__atomic_load_n(&_requestsLive, __ATOMIC_ACQUIRE) != 0)
+        return false;
+    // takes the dispatcher and the event source with it
+    _server->~WIFIConfigServer();
+    _server = NULL;
+    _events = NULL;
+    // nobody left to be writing to it
+    freeStage();
+    return true;
+}
+
+/** Body of a form posted by the portal page, decoded as it arrives */
+void WIFIConfigBase::handleWifiSaveBody(AsyncWebServerRequest * request, uint8_t *data, size_t len, size_t index, size_t /*total*/) {
+    if (index == 0) {
+        if (!request->contentType().startsWith(WC_FORM_CONTENT_TYPE))
+            return;
+        void *mem = malloc(sizeof(WCFormUpload));
+        if (mem == NULL)
+            return;
+        WCFormUpload *upload = new (mem) WCFormUpload();
+        upload->wc = this;
+        upload->slot = claimRecord();
+        upload->parser.begin(upload);
+        request->_tempObject = upload;
+    }
+
+    if (request->_tempObject != NULL)
+        ((WCFormUpload *)request->_tempObject)->parser.parse(data, len);
+}
+
+/** Handle the WLAN save form and redirect to WLAN config page again */
+void WIFIConfigBase::handleWifiSave(AsyncWebServerRequest * request) {
+    WC_STATS_BEGIN();
+
+    WCFormUpload *upload = (WCFormUpload *)request->_tempObject;
+    // a streamed form with nothing to decode it into. The server hasn't parsed it either,
+    // so carrying on would publish an empty config
+    if (upload == NULL && request->contentType().startsWith(WC_FORM_CONTENT_TYPE)) {
+        request->send(503, "text/plain", "Busy, try again");
+        return;
+    }
+    int slot = upload != NULL ? upload->slot : claimRecord();
+    if (slot < 0) {
+        // every record's taken, by config_loop not having caught up or by other uploads
+        request->send(503, "text/plain", "Busy, try again");
+        return;
+    }
+
+    if (upload != NULL) {
+        // streamed body, already decoded into the record
+        upload->parser.finish();
+        upload->publish();
+    }
+    else {
+        // plain GET or form POST, parsed by the web server. One pass, each field matched by hash
+        char *record = stageRecord(slot);
+        size_t count = request->params();
+        for (size_t i = 0; i < count; i++) {
+            AsyncWebParameter *field = request->getParam(i);
+            const String &name = field->name();
+            size_t cap;
+            char *dst = recordField(record, name.c_str(), name.length(), &cap);
+            if (dst == NULL)
+                continue;
+            strncpy(dst, field->value().c_str(), cap);
+            dst[cap] = 0;
+        }
+        publishRecord(slot);
+    }
+
+    sendPage(request, WC_PAGE_SAVED, WIFICONFIG_ROUTE_SAVE, WC_STATS_T0);
+    WC_LOGD(PAGE_SENT, "wifi save page", 0);
+}
+
+/** Provisioning API: GET /api/config describes the fields, POST /api/config sets them all at once
+ * from a flat JSON object, {"s":"ssid","p":"passkey","<param id>":"value",...} */
+void WIFIConfigBase::handleConfigSchema(AsyncWebServerRequest * request) {
+    sendPage(request, WC_PAGE_SCHEMA);
+}
+
+enum {
+    WC_FIELD_NONE,          // not submitted
+    WC_FIELD_OK,
+    WC_FIELD_TOO_LONG,
+    WC_FIELD_INVALID,       // not a string, or the parameter has nowhere to store it
+};
+
+/* per-request state of an upload, allocated with room for one status byte per field */
+struct WCConfigUpload : public WCConfigStage {
+    WCJSONParser  parser;
+    uint16_t      unknown;
+    uint16_t      fields;
+    uint8_t       status[1];
+
+    void fieldDone(const char *key, size_t keyLen, bool stored, bool truncated) override {
+        int field = wc->fieldIndex(key, keyLen);
+        if (field < 0 || field >= fields) {
+            unknown++;
+            return;
+        }
+        status[field] = !stored ? WC_FIELD_INVALID : truncated ? WC_FIELD_TOO_LONG : WC_FIELD_OK;
+    }
+};
+
+void WIFIConfigBase::handleConfigUploadBody(AsyncWebServerRequest * request, uint8_t *data, size_t len, size_t index, size_t /*total*/) {
+    if (index == 0) {
+        uint16_t fields = 2 + _paramsCount;
+        void *mem = malloc(sizeof(WCConfigUpload) + fields);
+        if (mem == NULL)
+            return;
+        WCConfigUpload *upload = new (mem) WCConfigUpload();
+        upload->wc = this;
+        upload->slot = claimRecord();
+        upload->fields = fields;
+        memset(upload->status, WC_FIELD_NONE, fields);
+        upload->parser.begin(upload);
+        request->_tempObject = upload;
+    }
+
+    if (request->_tempObject != NULL)
+        ((WCConfigUpload *)request->_tempObject)->parser.parse(data, len);
+}
+
+void WIFIConfigBase::handleConfigUpload(AsyncWebServerRequest * request) {
+    static const char * const names[] = { "", "ok", "too_long", "invalid" };
+    WCConfigUpload *upload = (WCConfigUpload *)request->_tempObject;
+
+    if (upload == NULL) {
+        request->send(415, "application/json", "{\"ok\":false,\"error\":\"expected a JSON object\"}");
+        return;
+    }
+    if (upload->slot < 0) {
+        request->send(503, "application/json", "{\"ok\":false,\"error\":\"busy\"}");
+        return;
+    }
+    if (!upload->parser.finish()) {
+        upload->release();
+        request->send(400, "application/json", "{\"ok\":false,\"error\":\"malformed JSON\"}");
+        return;
+    }
+
+    // everything submitted must have been taken as-is, and there has to be an SSID
+    bool ok = upload->status[0] == WC_FIELD_OK && stageRecord(upload->slot)[WC_REC_SSID] != 0;
+    for (uint16_t i = 0; i < upload->fields; i++) {
+        if (upload->status[i] == WC_FIELD_TOO_LONG || upload->status[i] == WC_FIELD_INVALID)
+            ok = false;
+    }
+
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->print(ok ? "{\"ok\":true,\"fields\":{" : "{\"ok\":false,\"fields\":{");
+    bool comma = false;
+    for (uint16_t i = 0; i < upload->fields; i++) {
+        if (upload->status[i] == WC_FIELD_NONE)
+            continue;
+        const char *name = i == 0 ? "s" : i == 1 ? "p" : _params[i - 2]->getID();
+        // IDs are whatever the sketch registered, escaped same as in the schema
+        response->print(comma ? ",\"" : "\"");
+        for (const char *c = name; *c; c++) {
+            char ent[7];
+            const char *e = jsonEscape(*c, ent);
+            if (e != NULL)
+                response->print(e);
+            else
+                response->write((uint8_t)*c);
+        }
+        response->printf("\":\"%s\"", names[upload->status[i]]);
+        comma = true;
+    }
+    response->printf("},\"unknown\":%u}", upload->unknown);
+    request->send(response);
+
+    WC_LOGI(API_CONFIG, ok ? "accepted" : "rejected", 0);
+    // all or nothing, a rejected upload never touches the live config
+    if (ok)
+        upload->publish();
+    else
+        upload->release();
+}
+
+/** Handle the info page */
+void WIFIConfigBase::handleInfo(AsyncWebServerRequest * request) {
+    WC_STATS_BEGIN();
+    sendPage(request, WC_PAGE_INFO, WIFICONFIG_ROUTE_INFO, WC_STATS_T0);
+    WC_LOGD(PAGE_SENT, "info page", 0);
+}
+
+/** Handle the reset page */
+void WIFIConfigBase::handleReset(AsyncWebServerRequest * request) {
+    WC_STATS_BEGIN();
+    sendPage(request, WC_PAGE_RESET, WIFICONFIG_ROUTE_RESET, WC_STATS_T0);
+    WC_LOGD(PAGE_SENT, "reset page", 0);
+    // the restart itself happens from config_loop, never from inside the web server
+    _restartRequested = true;
+}
+
+/* Streams the scan results as JSON, [["ssid",quality,secure],...], one network at a time.
+ * The table stays pinned for as long as this is around */
+class WIFIConfigScanJSON {
+  public:
+    WIFIConfigScanJSON(WIFIConfigBase *wc) : _wc(wc), _set(wc->pinNetworks()) {
+        _table = wc->_networks[_set];
+        _count = wc->_networkCount[_set];
+    }
+    ~WIFIConfigScanJSON() { _wc->unpinNetworks(_set); }
+
+    size_t        fill(uint8_t *buf, size_t maxLen);
+  private:
+    WIFIConfigBase *_wc;
+    uint8_t       _set;
+    const WIFIConfigNetwork *_table;
+    uint8_t       _count;
+    uint8_t       _idx    = 0;
+    bool          _done   = false;
+    // one entry, worst case every SSID byte needs a \u00XX escape
+    char          _entry[2 + 2 + 32 * 6 + 10];
+    size_t        _len    = 0;
+    size_t        _pos    = 0;
+
+    void          format(void);
+};
+
+void WIFIConfigScanJSON::format(void) {
+    const WIFIConfigNetwork *net = &_table[_idx];
+    size_t n = 0;
+
+    _entry[n++] = _idx == 0 ? '[' : ',';
+    _entry[n++] = '[';
+    _entry[n++] = '"';
+    for (const char *p = net->ssid; *p; p++) {
+        char ent[7];
+        const char *e = jsonEscape(*p, ent);
+        if (e == NULL) {
+            _entry[n++] = *p;
+            continue;
+        }
+        size_t len = strlen(e);
+        memcpy(_entry + n, e, len);
+        n += len;
+    }
+    n += snprintf(_entry + n, sizeof(_entry) - n, "\",%u,%u]", rssiToQuality(net->rssi), net->secure ? 1 : 0);
+
+    _len = n;
+    _pos = 0;
+    _idx++;
+}
+
+size_t WIFIConfigScanJSON::fill(uint8_t *buf, size_t maxLen) {
+    size_t n = 0;
+
+    while (n < maxLen) {
+        if (_pos < _len) {
+            size_t len = _len - _pos;
+            if (len > maxLen - n)
+                len = maxLen - n;
+            memcpy(buf + n, _entry + _pos, len);
+            n += len;
+            _pos += len;
+            continue;
+        }
+        if (_idx < _count) {
+            format();
+            continue;
+        }
+        if (_done)
+            break;
+
+        _entry[0] = _count == 0 ? '[' : ']';
+        _entry[1] = ']';
+        _len = _count == 0 ? 2 : 1;
+        _pos = 0;
+        _done = true;
+    }
+    return n;
+}
+
+/** Live updates */
+static const char * const WC_STATUS_TEXT[] = {
+    "",
+    "Saved, the portal will close shortly",
+    "Connecting...",
+    "Connected",
+    "Couldn't connect, check the details and try again",
+    "The portal is closing",
+};
+
+void WIFIConfigBase::pushEvent(uint8_t kind) {
+    __atomic_or_fetch(&_eventsPending, kind, __ATOMIC_RELAXED);
+}
+
+void WIFIConfigBase::setStatus(uint8_t status) {
+    _status = status;
+    pushEvent(WC_EVENT_STATUS);
+}
+
+void WIFIConfigBase::flushEvents(void) {
+    if (_events == NULL || millis() - _lastPush < WC_EVENT_INTERVAL_MS)
+        return;
+    uint8_t pending = __atomic_exchange_n(&_eventsPending, 0, __ATOMIC_ACQ_REL);
+    // nobody listening, nothing to catch up on later either: a new client gets the page as it is
+    if (pending == 0 || _events->count() == 0)
+        return;
+    // clients still sitting on earlier frames, try again next time
+    if (_events->avgPacketsWaiting() > 2) {
+        pushEvent(pending);
+        return;
+    }
+    _lastPush = millis();
+
+    if (pending & WC_EVENT_STATUS)
+        _events->send(WC_STATUS_TEXT[_status], "status");
+
+    if (pending & WC_EVENT_SCAN) {
+        // same JSON as /scan, sized with a dry run first
+        uint8_t tmp[64];
+        size_t len = 0, n;
+        WIFIConfigScanJSON sizing(this);
+        while ((n = sizing.fill(tmp, sizeof(tmp))) > 0)
+            len += n;
+
+        char *json = (char *)malloc(len + 1);
+        if (json == NULL) {
+            pushEvent(WC_EVENT_SCAN);
+            return;
+        }
+        WIFIConfigScanJSON render(this);
+        json[render.fill((uint8_t *)json, len)] = 0;
+        _events->send(json, "scan");
+        free(json);
+    }
+}
+
+/* An /events request hands its connection to the client and is deleted without its disconnect
+ * callback ever running, so the count it took at accept goes when the client's connection closes.
+ * Runs on the web task */
+void WIFIConfigBase::eventsConnected(AsyncEventSourceClient *client) {
+    client->client()->onDisconnect([this](void *r, AsyncClient *c) {
+        // what AsyncEventSourceClient would have done, then the count
+        ((AsyncEventSourceClient *)r)->_onDisconnect();
+        delete c;
+        __atomic_sub_fetch(&_requestsLive, 1, __ATOMIC_RELEASE);
+    }, client);
+    // a page that's opened late still gets where things are
+    uint8_t status = _status;
+    if (status != WC_STATUS_NONE)
+        client->send(WC_STATUS_TEXT[status], "status");
+}
+
+/** Handle the scan results, polled by the root page */
+void WIFIConfigBase::handleScan(AsyncWebServerRequest * request) {
+    std::shared_ptr<WIFIConfigScanJSON> json = std::make_shared<WIFIConfigScanJSON>(this);
+    AsyncWebServerResponse *response = request->beginChunkedResponse("application/json",
+        [json](uint8_t *buf, size_t maxLen, size_t /*index*/) -> size_t {
+            return json->fill(buf, maxLen);
+        });
+    response->addHeader("Cache-Control", "no-store");
+    request->send(response);
+}
+
+static void sendAsset(AsyncWebServerRequest * request, const char *type, const uint8_t *data, size_t len) {
+    AsyncWebServerResponse *response = request->beginResponse_P(200, type, data, len);
+    response->addHeader("Content-Encoding", "gzip");
+    // the URL changes with the content, so it never needs revalidating
+    response->addHeader("Cache-Control", "public, max-age=31536000, immutable");
+    request->send(response);
+}
+
+void WIFIConfigBase::handleStyle(AsyncWebServerRequest * request) {
+    sendAsset(request, "text/css", WC_STYLE_GZ, sizeof(WC_STYLE_GZ));
+}
+
+void WIFIConfigBase::handleScript(AsyncWebServerRequest * request) {
+    sendAsset(request, "application/javascript", WC_SCRIPT_GZ, sizeof(WC_SCRIPT_GZ));
+}
+
+enum {
+    WC_PROBE_REDIRECT,      // connectivity check, send it to the portal so the OS pops it up
+    WC_PROBE_GONE,          // something browsers fetch on their own, not worth a page
+};
+
+static const struct {
+    const char   *path;
+    uint8_t       action;
+} WC_PROBES[] = {
+    { "/generate_204",                      WC_PROBE_REDIRECT },    // Android
+    { "/gen_204",                           WC_PROBE_REDIRECT },
+    { "/hotspot-detect.html",               WC_PROBE_REDIRECT },    // Apple
+    { "/library/test/success.html",         WC_PROBE_REDIRECT },
+    { "/connecttest.txt",                   WC_PROBE_REDIRECT },    // Windows
+    { "/ncsi.txt",                          WC_PROBE_REDIRECT },
+    { "/redirect",                          WC_PROBE_REDIRECT },
+    { "/fwlink",                            WC_PROBE_REDIRECT },
+    { "/canonical.html",                    WC_PROBE_REDIRECT },    // Firefox
+    { "/success.txt",                       WC_PROBE_REDIRECT },
+    { "/favicon.ico",                       WC_PROBE_GONE },
+    { "/apple-touch-icon.png",              WC_PROBE_GONE },
+    { "/apple-touch-icon-precomposed.png",  WC_PROBE_GONE },
+    { "/robots.txt",                        WC_PROBE_GONE },
+};
+
+bool WIFIConfigBase::handleProbe(AsyncWebServerRequest * request) {
+    const char *url = request->url().c_str();
+    for (size_t i = 0; i < WC_ARRAY_LEN(WC_PROBES); i++) {
+        if (strcmp(url, WC_PROBES[i].path) != 0)
+            continue;
+        if (WC_PROBES[i].action == WC_PROBE_REDIRECT)
+            request->redirect(_portalURL);
+        else
+            request->send(404);
+        return true;
+    }
+    return false;
+}
+
+/** Anything else gets the config page, bar captive portal probes which get pointed at it */
+void WIFIConfigBase::handleNotFound(AsyncWebServerRequest * request) {
+    if (!admitClient(request))
+        return;
+    WC_STATS_BEGIN();
+    if (handleProbe(request)) {
+        WC_STATS_END(WIFICONFIG_ROUTE_NOTFOUND);
+        return;
+    }
+    sendPage(request, WC_PAGE_ROOT, WIFICONFIG_ROUTE_NOTFOUND, WC_STATS_T0);
+}
+
+#if defined(WC_ENABLE_STATS)
+/** Stats */
+const WIFIConfigStats& WIFIConfigBase::getStats(void) {
+    return _stats;
+}
+
+void WIFIConfigBase::resetStats(void) {
+    memset(&_stats, 0, sizeof(_stats));
+    _stats.minFreeHeap = UINT32_MAX;
+    _stats.minLargestBlock = UINT32_MAX;
+    _statsStart = millis();
+    _statsLastSample = _statsStart;
+    _dnsWindowStart = _statsStart;
+    _dnsWindowCount = 0;
+    sampleHeap();
+}
+
+void WIFIConfigBase::recordRoute(uint8_t route, uint32_t us) {
+    WIFIConfigRouteStats &r = _stats.routes[route];
+    if (r.count == 0 || us < r.minUs)
+        r.minUs = us;
+    if (us > r.maxUs)
+        r.maxUs = us;
+    r.totalUs += us;
+    r.count++;
+
+    if (_stats.firstServedMs == 0) {
+        uint32_t ms = millis() - _statsStart;
+        _stats.firstServedMs = ms > 0 ? ms : 1;
+    }
+    sampleHeap();
+}
+
+void WIFIConfigBase::recordDNS(uint16_t queries) {
+    _stats.dnsQueries += queries;
+    _dnsWindowCount += queries;
+}
+
+void WIFIConfigBase::sampleHeap(void) {
+    uint32_t heap = ESP.getFreeHeap();
+#if defined(ARDUINO_ARCH_ESP8266)
+    uint32_t block = ESP.getMaxFreeBlockSize();
+#elif defined(ARDUINO_ARCH_ESP32)
+    uint32_t block = ESP.getMaxAllocHeap();
+#endif
+    if (heap < _stats.minFreeHeap)
+        _stats.minFreeHeap = heap;
+    if (block < _stats.minLargestBlock)
+        _stats.minLargestBlock = block;
+}
+
+// called every config_loop pass, so the heap walk is rate-limited
+void WIFIConfigBase::sampleStats(void) {
+    unsigned long now = millis();
+    if (now - _statsLastSample >= 100) {
+        _statsLastSample = now;
+        sampleHeap();
+    }
+    if (now - _dnsWindowStart >= 1000) {
+        _stats.dnsPerSecond = _dnsWindowCount * 1000UL / (now - _dnsWindowStart);
+        if (_stats.dnsPerSecond > _stats.dnsPeakPerSecond)
+            _stats.dnsPeakPerSecond = _stats.dnsPerSecond;
+        _dnsWindowStart = now;
+        _dnsWindowCount = 0;
+    }
+}
+
+static const char * const WC_ROUTE_NAMES[WIFICONFIG_ROUTE_COUNT] = { "root", "wifisave", "info", "reset", "notfound" };
+
+/* stats as JSON, a piece at a time so the info page can stream it:
+ * the opening, one piece per route, then DNS/heap and timings. 0 once it's all out */
+size_t WIFIConfigBase::formatStats(char *buf, size_t len, uint8_t part) {
+    int n;
+
+    if (part == 0) {
+        n = snprintf(buf, len, "<script type='application/json' id='wcstats'>{\"routes\":{");
+    }
+    else if (part <= WIFICONFIG_ROUTE_COUNT) {
+        const WIFIConfigRouteStats &r = _stats.routes[part - 1];
+        n = snprintf(buf, len, "%s\"%s\":{\"n\":%lu,\"min\":%lu,\"avg\":%lu,\"max\":%lu}",
+                part > 1 ? "," : "", WC_ROUTE_NAMES[part - 1], (unsigned long)r.count, (unsigned long)r.minUs,
+                (unsigned long)(r.count ? r.totalUs / r.count : 0), (unsigned long)r.maxUs);
+    }
+    else if (part == WIFICONFIG_ROUTE_COUNT + 1) {
+        n = snprintf(buf, len, "},\"dns\":{\"total\":%lu,\"rate\":%lu,\"peak\":%lu},\"heap\":{\"min\":%lu,\"block\":%lu}",
+                (unsigned long)_stats.dnsQueries, (unsigned long)_stats.dnsPerSecond, (unsigned long)_stats.dnsPeakPerSecond,
+                (unsigned long)_stats.minFreeHeap, (unsigned long)_stats.minLargestBlock);
+    }
+    else if (part == WIFICONFIG_ROUTE_COUNT + 2) {
+        n = snprintf(buf, len, ",\"first_client_ms\":%lu,\"first_served_ms\":%lu,\"complete_ms\":%lu}</script>",
+                (unsigned long)_stats.firstClientMs, (unsigned long)_stats.firstServedMs, (unsigned long)_stats.completeMs);
+    }
+    else {
+        return 0;
+    }
+
+    return n < 0 ? 0 : ((size_t)n < len ? n : len - 1);
+}
+#endif
+
+//start up save config callback
+void WIFIConfigBase::setSaveConfigCallback( void (*func)(void) ) {
+    _savecallback = func;
+}
+
+//sets a custom element to add to head, like a new style tag
+void WIFIConfigBase::setCustomHeadElement(const char* element) {
+    if (element == NULL)
+        element = "";
+    _customHeadElement = element;
+    _customHeadSegCount = wc_split_template(element, "v", _customHeadSegs, WIFICONFIG_HEAD_SEGMENTS);
+    _pageGeneration++;
+}
+
+void WIFIConfigBase::cleanup(void) {
+    if (_scanning) {
+        WiFi.scanDelete();
+        _scanning = false;
+    }
+    if (_dns != NULL) {
+        _dns->stop();
+        _dns->~WIFIConfigDNS();
+        _dns = NULL;
+    }
+    watchStations(false);
+    WiFi.softAPdisconnect(true);
+    WiFi.mode(WIFI_STA);
+    for (size_t i = 0; i < sizeof(_pageCache) / sizeof(_pageCache[0]); i++)
+        _pageCache[i].reset();
+
+    if (_server != NULL) {
+        _server->end();
+        _events->close();
+        if (!releaseServer())
+            WC_LOGW(SERVER_KEPT, 0, 0);
+    }
 }
@@ -19,33 +19,136 @@
 #elif defined(ARDUINO_ARCH_ESP32)
     #include <WiFi.h>
     #include <AsyncTCP.h>
+    #include <freertos/FreeRTOS.h>
+    #include <freertos/task.h>
 #endif
 
 #include <ESPAsyncWebServer.h>
-#include <DNSServer.h>
 #include <memory>
+#include <limits.h>
+#include "wctemplate.h"
+#include "wcdns.h"
+#include "wcform.h"
+#include "wcfast.h"
 
 //#define WC_ENABLE_DEBUG
+// or pick a level from wclog.h, anything above it compiles out
+//#define WC_LOG_LEVEL WC_LOG_INFO
 
-#if defined(WC_ENABLE_DEBUG)
-    #define WC_DEFAULT_STREAM          Serial
+#include "wclog.h"
 
-    #define WC_DEBUG_PRINT(x)          WC_DEFAULT_STREAM.print(x)
-    #define WC_DEBUG_PRINTLN(x)        WC_DEFAULT_STREAM.println(x)
-    #define WC_DEBUG_DEC(x)            WC_DEFAULT_STREAM.print(x)
-    #define WC_DEBUG_DECLN(x)          WC_DEFAULT_STREAM.println(x)
-    #define WC_DEBUG_HEX(x)            WC_DEFAULT_STREAM.print(x, HEX)
-    #define WC_DEBUG_HEXLN(x)          WC_DEFAULT_STREAM.println(x, HEX) 
+//#define WC_ENABLE_STATS
+
+#if defined(WC_ENABLE_STATS)
+    #define WC_STATS_BEGIN()            uint32_t _wc_stats_t0 = micros()
+    #define WC_STATS_T0                 _wc_stats_t0
+    #define WC_STATS_END(route)         recordRoute(route, micros() - _wc_stats_t0)
+    #define WC_STATS_SAMPLE()           sampleStats()
+    #define WC_STATS_DNS(n)             recordDNS(n)
 #else
-    #define WC_DEBUG_PRINT(x)
-    #define WC_DEBUG_PRINTLN(x)
-    #define WC_DEBUG_DEC(x)          
-    #define WC_DEBUG_DECLN(x)
-    #define WC_DEBUG_HEX(x)
-    #define WC_DEBUG_HEXLN(x)
+    #define WC_STATS_BEGIN()
+    #define WC_STATS_T0                 0
+    #define WC_STATS_END(route)
+    #define WC_STATS_SAMPLE()
+    #define WC_STATS_DNS(n)             (void)(n)
 #endif
 
+//#define WC_ENABLE_STORE
+
+#if defined(WC_ENABLE_STORE)
+    #include "wcstore.h"
+#endif
+
+// max SSID and passkey lengths, excluding the nul
+#define WC_SSID_MAX_LEN       32
+#define WC_PASS_MAX_LEN       64
+
+// content type the portal page posts its form with, so the body reaches the streaming parser
+// rather than being parsed into Strings by the web server
+#define WC_FORM_CONTENT_TYPE  "application/x-wc-form"
+
+// default parameter capacity, use WIFIConfigT<N> for a different one
 #define WIFICONFIG_MAX_PARAMS 10
+// max number of {v} placeholders recognised in the custom head element, plus one
+#define WIFICONFIG_HEAD_SEGMENTS 4
+
+// max number of nearby networks listed in the portal
+#if !defined(WIFICONFIG_MAX_NETWORKS)
+    #define WIFICONFIG_MAX_NETWORKS 10
+#endif
+
+// default memory budget for cached pages, in bytes, 0 disables the cache
+#if !defined(WIFICONFIG_PAGE_CACHE_SIZE)
+    #if defined(ARDUINO_ARCH_ESP8266)
+        #define WIFICONFIG_PAGE_CACHE_SIZE 0
+    #else
+        #define WIFICONFIG_PAGE_CACHE_SIZE 8192
+    #endif
+#endif
+
+// default cap on pages being streamed out at once, further requests get a 503 until one finishes. 0 means no cap
+#if !defined(WIFICONFIG_MAX_RENDERS)
+    #if defined(ARDUINO_ARCH_ESP8266)
+        #define WIFICONFIG_MAX_RENDERS 2
+    #else
+        #define WIFICONFIG_MAX_RENDERS 4
+    #endif
+#endif
+
+// default page/probe requests allowed per client per second, more get a 429. 0 means no limit
+#if !defined(WIFICONFIG_RATE_LIMIT)
+    #define WIFICONFIG_RATE_LIMIT 10
+#endif
+// number of clients tracked for rate limiting, the least recently seen one makes way for a new one
+#define WIFICONFIG_RATE_CLIENTS 8
+
+// how long the portal waits, in ms, for the AP to settle, and for the last page to go out before shutting down
+#define WC_AP_SETTLE_MS       500
+#define WC_AP_RETRY_MS        100
+#define WC_SAVE_DRAIN_MS      1000
+#define WC_RESTART_DRAIN_MS   2000
+// max time, in ms, the portal waits on requests still in progress before tearing the server down
+#define WC_TEARDOWN_MS        2000
+#if defined(ARDUINO_ARCH_ESP32)
+// portal task, see setPortalTask(): how often it runs, and where
+    #if !defined(WC_TASK_PERIOD_MS)
+        #define WC_TASK_PERIOD_MS   10
+    #endif
+    #if !defined(WC_TASK_CORE)
+        #define WC_TASK_CORE        0
+    #endif
+    #if !defined(WC_TASK_PRIORITY)
+        #define WC_TASK_PRIORITY    1
+    #endif
+    // stack in bytes. The task runs cleanup() and, with the store on, saveConfig()'s LittleFS write,
+    // which alone takes ~2-3KB on top of the page and JSON work, hence the extra room
+    #if !defined(WC_TASK_STACK)
+        #if defined(WC_ENABLE_STORE)
+            #define WC_TASK_STACK   8192
+        #else
+            #define WC_TASK_STACK   4096
+        #endif
+    #endif
+#endif
+
+// least time between pushes to /events clients, in ms. Whatever changes in between goes out together
+#if !defined(WC_EVENT_INTERVAL_MS)
+    #define WC_EVENT_INTERVAL_MS  500
+#endif
+
+// longest wait config_loop(&idleMs) suggests while the portal's up. DNS queries and finished requests
+// arrive with nothing to say so, this bounds how long they sit. Raise it to trade latency for sleep
+#if !defined(WC_IDLE_POLL_MS)
+    #define WC_IDLE_POLL_MS       50
+#endif
+
+// how long fastConnect() gives the remembered AP before falling back to a full connect, in ms
+#if !defined(WC_FAST_CONNECT_MS)
+    #define WC_FAST_CONNECT_MS  3000
+#endif
+
+// number of submitted configs that can be staged at once, waiting on config_loop or still being received
+#define WC_STAGE_SLOTS        3
 
 enum {
     WIFICONFIG_COMPLETE,
@@ -54,6 +157,68 @@ enum {
     WIFICONFIG_TIMEOUT,
 };
 
+class WIFIConfigPage;
+class WIFIConfigHandler;
+struct WCCachedPage;
+struct WCConfigStage;
+class WIFIConfigBase;
+
+/* AsyncWebServer that counts its connections from the moment they're accepted, rather than once a request's
+ * been parsed far enough to reach a handler, so it's never destroyed under a client it hasn't seen yet */
+class WIFIConfigServer : public AsyncWebServer {
+  public:
+    WIFIConfigServer(WIFIConfigBase *wc);
+};
+struct WCConfigUpload;
+
+enum {
+    WIFICONFIG_ROUTE_ROOT,
+    WIFICONFIG_ROUTE_SAVE,
+    WIFICONFIG_ROUTE_INFO,
+    WIFICONFIG_ROUTE_RESET,
+    WIFICONFIG_ROUTE_NOTFOUND,
+    WIFICONFIG_ROUTE_COUNT,
+};
+
+// response time for one route, in microseconds: from its handler starting to the last of the body being
+// produced. Pages are rendered as the client takes them, so this includes the client's pace
+struct WIFIConfigRouteStats {
+    uint32_t    count;
+    uint32_t    minUs;
+    uint32_t    maxUs;
+    uint32_t    totalUs;        // average is totalUs / count
+};
+
+// portal costs, only collected with WC_ENABLE_STATS defined
+struct WIFIConfigStats {
+    WIFIConfigRouteStats routes[WIFICONFIG_ROUTE_COUNT];
+    uint32_t    dnsQueries;         // total handled
+    uint32_t    dnsPerSecond;       // over the last full second
+    uint32_t    dnsPeakPerSecond;
+    uint32_t    minFreeHeap;
+    uint32_t    minLargestBlock;    // smallest 'largest free block' seen
+    uint32_t    firstClientMs;      // from startConfigPortal to the first connection accepted, 0 until then
+    uint32_t    firstServedMs;      // from startConfigPortal to the first timed route finishing, 0 until then
+    uint32_t    completeMs;         // from startConfigPortal to WIFICONFIG_COMPLETE, 0 until then
+};
+
+// station connect timings, in ms
+struct WIFIConfigConnectStats {
+    uint32_t    lastMs;             // the last connect() or fastConnect(), whether it worked or not
+    bool        lastFast;           // the last one got through on the remembered AP
+    uint16_t    fastConnects;
+    uint16_t    fullConnects;
+    uint16_t    fastFallbacks;      // remembered AP didn't work out, fell back to a full connect
+    uint32_t    fastTotalMs;        // over all successful fast connects, average is fastTotalMs / fastConnects
+    uint32_t    fullTotalMs;
+};
+
+struct WIFIConfigNetwork {
+    char        ssid[33];
+    int8_t      rssi;
+    bool        secure;
+};
+
 class WIFIConfigParam {
   public:
     WIFIConfigParam(const char *custom);
@@ -71,17 +236,24 @@ class WIFIConfigParam {
     char       *_value;
     int         _length;
     const char *_customHTML;
+    uint16_t    _stageOffset;       // where the value sits in a staged config record, 0 if it has no room there
 
     void init(const char *id, const char *placeholder, const char *custom);
 
-    friend class WIFIConfig;
+    friend class WIFIConfigBase;
 };
 
+// smallest power of 2 that's at least n
+constexpr uint16_t wc_pow2_at_least(uint16_t n, uint16_t p = 1) {
+    return p >= n ? p : wc_pow2_at_least(n, p * 2);
+}
+
 
-class WIFIConfig
+/* The portal itself. Storage for the parameter list, its lookup table and the value arena
+ * is supplied by WIFIConfigT below, so the capacity is fixed at compile time */
+class WIFIConfigBase
 {
   public:
-    WIFIConfig(const char * page_title = NULL);
 
     //if you want to always start the config portal, without trying to connect first
     boolean       startConfigPortal();
@@ -101,58 +273,351 @@ class WIFIConfig
     //adds a custom parameter, additional parameters include a buffer for storing the parameter,
     // its length and if there's a default value stored within the buffer
     void          addParameter(WIFIConfigParam *p, char *buffer, int length, bool hasDefault = false);
+    //same, but with a buffer of 'length' + 1 bytes carved out of the library's value arena,
+    // optionally initialised to a default value
+    void          addParameter(WIFIConfigParam *p, int length, const char *defaultValue = NULL);
     /* this resets the parameter list to zero so you can re-add parameters */
     void          resetParameterList(void);
-    //TODO
     //if this is set, customise style
+    //any {v} in the element is replaced with the page title
     void          setCustomHeadElement(const char* element);
+    //max memory to spend caching rendered pages, 0 turns the cache off
+    void          setPageCacheSize(size_t bytes);
+    //how often to rescan for nearby networks while the portal is up, in seconds, 0 disables scanning
+    void          setScanInterval(unsigned long seconds);
+    //try a submitted config's network for up to this many seconds before closing the portal, telling
+    //the page how it went. If it fails the portal stays up for another go. 0, the default, closes it
+    //as soon as a config's received. The AP moves to the network's channel while trying
+    void          setConnectCheck(unsigned long seconds);
+    //max pages streamed out at once, 0 for no cap
+    void          setMaxConcurrentRenders(uint8_t renders);
+    //max page requests per client per second, 0 for no limit
+    void          setRequestRateLimit(uint8_t perSecond);
+    //networks seen in the last scan, strongest first
+    uint8_t       getNetworkCount(void);
+    const WIFIConfigNetwork * getNetwork(uint8_t i);
 
     // get the WIFI ssid and key after configuration,
     // pass in a buffer and the maximum number of characters to copy
     bool          get_wifi_ssid(char * ssidbuf, uint16_t len);
     bool          get_wifi_passkey(char * keybuf, uint16_t len);
     uint8_t       config_loop(void);
+    //same, also setting 'idleMs' to how long it can be left before the next call, for sleeping or yielding
+    //instead of spinning. It's the time to the nearest timeout, scan, push or teardown step, capped at
+    //WC_IDLE_POLL_MS while the portal's up; 0 if there's work waiting, ULONG_MAX once there's nothing left to do
+    uint8_t       config_loop(unsigned long *idleMs);
+#if defined(ARDUINO_ARCH_ESP32)
+    //run DNS, scanning, timeouts and teardown on a task of their own, pinned to WC_TASK_CORE, so the portal
+    //keeps going however long loop() takes. config_loop() then only reports the state, and runs the save
+    //callback once the portal's done. Takes effect on the next startConfigPortal()
+    void          setPortalTask(bool enable);
+#endif
+#if defined(WC_ENABLE_STORE)
+    //load the last saved config if there is one, otherwise start the config portal.
+    //Either way config_loop() then carries on as usual, returning WIFICONFIG_COMPLETE straight away after a load
+    boolean       autoConfigPortal(char const *apName, char const *apPassword = NULL);
+    //read the saved config into the SSID/passkey and parameter buffers. It's only used if it was
+    //saved with the same parameter IDs and lengths as are registered now
+    bool          loadConfig(void);
+    //save the current config, done automatically whenever the portal completes
+    bool          saveConfig(void);
+    //forget the saved config, so the portal comes up next time
+    void          eraseConfig(void);
+#endif
+
+    // connect to 'ssid' as a station, waiting up to 'timeout' ms. If it works, the AP's BSSID and channel,
+    // plus the DHCP lease if 'keepLease', are remembered in RTC memory for fastConnect()
+    bool          connect(const char *ssid, const char *pass, unsigned long timeout, bool keepLease = false);
+    // same, but going straight to the remembered AP, with the remembered lease if there is one,
+    // as long as it was remembered for these credentials. Falls back to connect() if that fails
+    bool          fastConnect(const char *ssid, const char *pass, unsigned long timeout, bool keepLease = false);
+    // forget the remembered AP, say when the network's known to have changed
+    void          forgetFastConnect(void);
+    const WIFIConfigConnectStats & getConnectStats(void);
+#if defined(WC_ENABLE_STATS)
+    const WIFIConfigStats & getStats(void);
+#endif
+  protected:
+    WIFIConfigBase(const char * page_title, WIFIConfigParam **params, uint8_t *index,
+                   uint16_t maxParams, uint16_t indexSize, char *arena, size_t arenaSize);
   private:
-    std::unique_ptr<DNSServer>        dnsServer;
-    
-    /* AsyncWebServer causes an exception when deleted,
-     * there's no stop() or close(), reset() frees everything but 
-     * there's no easy way to restart the server if it's needed short of creating a new instance,
-     * and if you do that with startConfigPortal(), the old one's still hanging around, un-deletable and leaking memory,
-     * so we'll just have to live with a member variable for now if we ever want to reuse the server */
-    AsyncWebServer server;
-    
+    /* The web server and DNS responder only exist while the portal's up. They're built in storage owned
+     * by the library and destroyed again in cleanup(), so nothing of theirs stays on the heap afterwards.
+     * AsyncWebServer falls over if it's destroyed with clients still attached, so it's stopped first and
+     * only goes once the last connection has closed; until then it's kept, closed, and config_loop retries.
+     * The server deletes its handlers along with itself, so every route goes through the one dispatcher,
+     * added whenever the server's built, which looks requests up in the _routes table */
+    alignas(WIFIConfigServer) uint8_t _serverStorage[sizeof(WIFIConfigServer)];
+    alignas(WIFIConfigDNS) uint8_t _dnsStorage[sizeof(WIFIConfigDNS)];
+    WIFIConfigServer *_server             = NULL;
+    WIFIConfigDNS *_dns                   = NULL;
+    // connections accepted by the server that haven't closed yet, /events streams included
+    uint32_t      _requestsLive           = 0;
+    // destroy the server if nothing's connected to it any more, true once it's gone
+    bool          releaseServer(void);
+
+    struct WCRoute {
+        const char   *uri;
+        WebRequestMethodComposite methods;
+        void (WIFIConfigBase::*onRequest)(AsyncWebServerRequest *);
+        void (WIFIConfigBase::*onBody)(AsyncWebServerRequest *, uint8_t *, size_t, size_t, size_t);
+    };
+    static const WCRoute _routes[];
+    const WCRoute *findRoute(AsyncWebServerRequest * request);
+    AsyncWebHandler *newDispatcher(void);
+
     void          setupConfigPortal();
+    void          startDNS();
+
+    /* internal portal state, advanced by config_loop against deadlines rather than by waiting */
+    enum {
+        WC_PORTAL_IDLE,
+        WC_PORTAL_AP_STARTING,      // AP is up, waiting for it to settle before starting DNS
+        WC_PORTAL_RUNNING,
+        WC_PORTAL_DRAINING,         // config received, letting the response go out
+        WC_PORTAL_VERIFYING,        // config received, trying its network before closing, see setConnectCheck()
+        WC_PORTAL_TEARDOWN,         // server stopped, waiting for requests in progress to finish
+        WC_PORTAL_RESTARTING,       // reset requested, letting the response go out
+    };
+    uint8_t       _portalState            = WC_PORTAL_IDLE;
+    unsigned long _portalDeadline         = 0;
+    volatile bool _restartRequested       = false;
+    uint8_t       _portalResult           = WIFICONFIG_COMPLETE;    // what config_loop reports once torn down
+    void          beginTeardown(uint8_t result);
+    unsigned long _connectCheck           = 0;
+    void          beginVerify(void);
+    // advance the portal state machine, from config_loop or the portal task
+    void          portalStep(void);
+    // how long portalStep can be left before it has something to do
+    unsigned long portalIdle(void);
+    // DNS budget used up on the last pass, so there's more waiting
+    bool          _dnsBacklog             = false;
+    void          serviceDNS(void);
+    // save callback due, it's always called from config_loop
+    bool          _callbackPending        = false;
+
+#if defined(ARDUINO_ARCH_ESP32)
+    bool          _useTask                = false;
+    TaskHandle_t  _task                   = NULL;
+    // set by the task as it exits, config_loop takes over from there
+    bool          _taskDone               = false;
+    static void   portalTask(void *arg);
+#endif
 
     const char*   _apName                 = "no-net";
     const char*   _apPassword             = NULL;
-    String        _ssid                   = "";
-    String        _pass                   = "";
+    char          _ssid[WC_SSID_MAX_LEN + 1];
+    char          _pass[WC_PASS_MAX_LEN + 1];
     unsigned long _configPortalTimeout    = 0;
     unsigned long _configPortalStart      = 0;
 
+    /* stations on the AP, counted from WiFi events while the portal's up rather than polled.
+     * The timeout only runs while there are none, from when the last one left */
+    volatile uint8_t _stations            = 0;
+#if defined(ARDUINO_ARCH_ESP8266)
+    WiFiEventHandler _stationJoinedHandler;
+    WiFiEventHandler _stationLeftHandler;
+#elif defined(ARDUINO_ARCH_ESP32)
+    wifi_event_id_t _stationEvents        = 0;
+#endif
+    void          watchStations(bool enable);
+    void          stationJoined(void);
+    void          stationLeft(void);
+
     int           _paramsCount            = 0;
 
+    /* parameter list, plus an open-addressed hash table of indices into it keyed on the parameter ID,
+     * so a submitted field finds its parameter without a scan */
+    WIFIConfigParam **_params;
+    uint16_t      _maxParams;
+    uint8_t      *_paramIndex;
+    uint16_t      _paramIndexSize;          // power of 2, at least twice _maxParams
+    char         *_arena;
+    size_t        _arenaSize;
+    size_t        _arenaUsed              = 0;
+
+    void          indexParam(uint8_t i);
+    int           findParam(const char *id, size_t len);
+
+    /* Submissions are decoded by the web task into a ring of fixed-size config records, published
+     * with atomics, and config_loop commits the latest complete one into _ssid, _pass and the
+     * parameter buffers. Each slot's state is FREE, WRITING, or its sequence number once READY.
+     * Only the web task moves a slot out of FREE, only config_loop moves it back.
+     * Any connection may hold a slot it's writing to until it closes, so the ring lives exactly as
+     * long as the server does: it goes in releaseServer(), never while a connection's open */
+    enum {
+        WC_SLOT_FREE,
+        WC_SLOT_WRITING,
+        WC_SLOT_READY,              // and up
+    };
+    uint32_t      _slotState[WC_STAGE_SLOTS];
+    char         *_stage                  = NULL;     // WC_STAGE_SLOTS records, allocated along with the server
+    size_t        _recordSize             = 0;
+    uint32_t      _stageSeq               = WC_SLOT_READY;
+
+    bool          allocStage(void);
+    void          freeStage(void);
+    char         *stageRecord(int slot) { return _stage + slot * _recordSize; }
+    int           claimRecord(void);
+    void          publishRecord(int slot);
+    void          releaseRecord(int slot);
+    // copy the latest published record into place, true if there was one
+    bool          commitRecord(void);
+    // where field 'key' goes in a record, and how much room it has there
+    char         *recordField(char *record, const char *key, size_t keyLen, size_t *cap);
+    // 0 for the SSID, 1 for the passkey, 2 + index for parameters, -1 if it's none of those
+    int           fieldIndex(const char *key, size_t keyLen);
+
     const char*   _customHeadElement      = "";
+    WCSegment     _customHeadSegs[WIFICONFIG_HEAD_SEGMENTS];
+    uint8_t       _customHeadSegCount     = 0;
     const char*   _page_title;
     
+    // stream one of the portal pages into a chunked response
+    // 'route' and 'start' (micros(), WC_STATS_T0) are for the route stats, the time's taken when the page is done
+    void          sendPage(AsyncWebServerRequest * request, uint8_t kind, uint8_t route = WIFICONFIG_ROUTE_COUNT, uint32_t start = 0);
+
+    // rendered pages, with an ETag each. Entries are shared with any response still sending them
+    std::shared_ptr<WCCachedPage> _pageCache[3];
+    size_t        _pageCacheSize          = WIFICONFIG_PAGE_CACHE_SIZE;
+    // bumped whenever page content changes, stale cache entries get dropped on the next request
+    volatile uint32_t _pageGeneration     = 0;
+    uint32_t      pageKey(void);
+    bool          sendCachedPage(AsyncWebServerRequest * request, uint8_t kind);
+
+    /* admission control, all of it only ever touched from the web task */
+    uint8_t       _maxRenders             = WIFICONFIG_MAX_RENDERS;
+    uint8_t       _rendersInFlight        = 0;
+    uint8_t       _rateLimit              = WIFICONFIG_RATE_LIMIT;
+    struct {
+        uint32_t  ip;
+        unsigned long windowStart;
+        uint8_t   count;
+    }             _clients[WIFICONFIG_RATE_CLIENTS];
+    // false, with a 429 sent, if the client's over its rate
+    bool          admitClient(AsyncWebServerRequest * request);
+
+    // where captive portal probes get redirected, set once the AP has an address
+    char          _portalURL[24];
+    // answer OS connectivity checks and other known junk without rendering anything, false if it isn't one
+    bool          handleProbe(AsyncWebServerRequest * request);
+
     void          handleRoot(AsyncWebServerRequest * request);
     void          handleWifiSave(AsyncWebServerRequest * request);
+    void          handleWifiSaveBody(AsyncWebServerRequest * request, uint8_t *data, size_t len, size_t index, size_t total);
+    void          handleConfigSchema(AsyncWebServerRequest * request);
+    void          handleConfigUpload(AsyncWebServerRequest * request);
+    void          handleConfigUploadBody(AsyncWebServerRequest * request, uint8_t *data, size_t len, size_t index, size_t total);
     void          handleInfo(AsyncWebServerRequest * request);
     void          handleReset(AsyncWebServerRequest * request);
     void          handleNotFound(AsyncWebServerRequest * request);
+    void          handleStyle(AsyncWebServerRequest * request);
+    void          handleScript(AsyncWebServerRequest * request);
+    void          handleScan(AsyncWebServerRequest * request);
     boolean       configPortalHasTimeout();
     void          cleanup(void);
 
     // DNS server
     const byte    DNS_PORT = 53;
 
-    boolean       recvd_config = false;
     uint8_t       config_state = WIFICONFIG_NOTSTARTED;
     
     void (*_savecallback)(void) = NULL;
 
-    WIFIConfigParam* _params[WIFICONFIG_MAX_PARAMS];
+#if defined(WC_ENABLE_STORE)
+    WCStore       _store;
+    // parameter 'i' if it has a buffer to save and load, NULL otherwise
+    WIFIConfigParam *storedParam(int i);
+    // identifies the stored layout: SSID/passkey sizes plus every stored parameter's ID and length
+    uint32_t      storeSchema(void);
+    // CRC of the stored fields, in storage order
+    uint32_t      storeCRC(uint32_t *length);
+#endif
+
+    WIFIConfigConnectStats _connectStats;
+    bool          waitConnected(unsigned long deadline, bool fast);
+    void          recordConnect(unsigned long start, bool fast, bool ok);
+
+    /* scan results, double-buffered: config_loop fills the back table then flips, so handlers never
+     * wait on the radio. A response going through a table pins it, and new results wait while the
+     * back table's pinned, so a table never changes under a response however slow its client */
+    WIFIConfigNetwork _networks[2][WIFICONFIG_MAX_NETWORKS];
+    uint8_t       _networkCount[2]        = {0, 0};
+    volatile uint8_t _networksFront       = 0;
+    uint8_t       _networksPinned[2]      = {0, 0};
+    uint8_t       pinNetworks(void);
+    void          unpinNetworks(uint8_t set);
+    unsigned long _scanInterval           = 30000;
+    unsigned long _lastScan               = 0;
+    bool          _scanning               = false;
+    void          updateScan(void);
+
+    /* live updates for the portal page over server-sent events on /events. Anyone can flag an update,
+     * flushEvents() sends what's flagged at most every WC_EVENT_INTERVAL_MS, built from the latest state,
+     * so a burst of changes costs one frame per client */
+    enum {
+        WC_EVENT_SCAN             = 0x01,     // new scan results
+        WC_EVENT_STATUS           = 0x02,     // _status changed
+    };
+    enum {
+        WC_STATUS_NONE,
+        WC_STATUS_SAVED,
+        WC_STATUS_CONNECTING,
+        WC_STATUS_CONNECTED,
+        WC_STATUS_CONNECT_FAILED,
+        WC_STATUS_CLOSING,
+    };
+    AsyncEventSource *_events             = NULL;     // owned by the server
+    uint8_t       _eventsPending          = 0;
+    volatile uint8_t _status              = WC_STATUS_NONE;
+    unsigned long _lastPush               = 0;
+    void          pushEvent(uint8_t kind);
+    void          setStatus(uint8_t status);
+    void          flushEvents(void);
+    // takes over the count of a request that's become an /events stream
+    void          eventsConnected(AsyncEventSourceClient *client);
+
+#if defined(WC_ENABLE_STATS)
+    WIFIConfigStats _stats;
+    unsigned long _statsStart             = 0;
+    unsigned long _statsLastSample        = 0;
+    unsigned long _dnsWindowStart         = 0;
+    uint32_t      _dnsWindowCount         = 0;
+    void          resetStats(void);
+    void          recordRoute(uint8_t route, uint32_t us);
+    void          recordDNS(uint16_t queries);
+    size_t        formatStats(char *buf, size_t len, uint8_t part);
+    void          sampleHeap(void);
+    void          sampleStats(void);
+#endif
+
+    friend class WIFIConfigPage;
+    friend class WIFIConfigHandler;
+    friend class WIFIConfigServer;
+    friend class WIFIConfigScanJSON;
+    friend struct WCConfigStage;
+    friend struct WCConfigUpload;
 };
 
+#define WC_NO_PARAM     0xFF
+
+/* WIFIConfig with room for 'MaxParams' parameters, and an 'ArenaSize'-byte arena for
+ * parameter values that don't come with their own buffer */
+template <uint16_t MaxParams = WIFICONFIG_MAX_PARAMS, size_t ArenaSize = 0>
+class WIFIConfigT : public WIFIConfigBase
+{
+  public:
+    WIFIConfigT(const char * page_title = NULL) :
+        WIFIConfigBase(page_title, _paramSlots, _indexSlots, MaxParams, IndexSize, _arenaBuf, ArenaSize) {}
+  private:
+    static_assert(MaxParams > 0 && MaxParams < WC_NO_PARAM, "MaxParams must be between 1 and 254");
+    static constexpr uint16_t IndexSize = wc_pow2_at_least(2 * MaxParams);
+
+    WIFIConfigParam* _paramSlots[MaxParams];
+    uint8_t       _indexSlots[IndexSize];
+    char          _arenaBuf[ArenaSize > 0 ? ArenaSize : 1];
+};
+
+typedef WIFIConfigT<> WIFIConfig;
+
 #endif